@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+namespace json_fragments {
+namespace bench {
+
+// Number of allocations the process has made through operator new, in any
+// of its forms. Linking allocation_counter.cpp replaces the global
+// operators; they live in their own file so no caller sees their bodies.
+size_t allocation_count();
+
+} // namespace bench
+} // namespace json_fragments
@@ -0,0 +1,264 @@
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/delimiter_scanner.hpp"
+#include "json_fragments/dependency_tracker.hpp"
+#include "fragment_generators.hpp"
+
+using namespace json_fragments;
+using namespace json_fragments::bench;
+
+namespace {
+
+// Parsing and cycle-checking a whole catalogue
+void BM_Compile(benchmark::State& state) {
+    auto fragments = make_catalogue(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        auto compiled = CompiledFragmentSet::compile(fragments);
+        benchmark::DoNotOptimize(compiled);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Compile)->RangeMultiplier(8)->Range(64, 8192)->Unit(benchmark::kMicrosecond);
+
+// The same, parsing fragments on a pool with one thread per core
+void BM_CompileParallel(benchmark::State& state) {
+    auto fragments = make_catalogue(static_cast<size_t>(state.range(0)));
+    ThreadPool pool;
+    for (auto _ : state) {
+        auto compiled = CompiledFragmentSet::compile(fragments, {}, &pool);
+        benchmark::DoNotOptimize(compiled);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CompileParallel)->RangeMultiplier(8)->Range(64, 8192)->Unit(benchmark::kMicrosecond);
+
+// Mapping back a plan saved from the same catalogue, the warm-start
+// alternative to BM_Compile
+void BM_LoadPlan(benchmark::State& state) {
+    auto path = (std::filesystem::temp_directory_path() / "json_fragments_bench.plan").string();
+    {
+        std::ofstream out(path, std::ios::binary);
+        CompiledFragmentSet::compile(make_catalogue(static_cast<size_t>(state.range(0)))).save(out);
+    }
+    for (auto _ : state) {
+        auto loaded = CompiledFragmentSet::load(path);
+        benchmark::DoNotOptimize(loaded);
+    }
+    std::remove(path.c_str());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LoadPlan)->RangeMultiplier(8)->Range(64, 8192)->Unit(benchmark::kMicrosecond);
+
+// Parse plus evaluate through the one-shot API
+void BM_ResolveUncompiled(benchmark::State& state) {
+    auto fragments = make_catalogue(static_cast<size_t>(state.range(0)));
+    JsonResolver resolver;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(resolver.resolve(fragments, "root"));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ResolveUncompiled)->RangeMultiplier(8)->Range(64, 8192)->Unit(benchmark::kMicrosecond);
+
+// Resolves documents with large literal bodies from a map the call owns,
+// copying the values (consume=0) or moving them out of the map (consume=1).
+// The map is copied outside the timed region.
+void BM_ResolveOwnedMap(benchmark::State& state) {
+    const auto fragments = make_documents(static_cast<size_t>(state.range(0)), 4096);
+    JsonResolver resolver;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto owned = fragments;
+        state.ResumeTiming();
+        if (state.range(1)) {
+            benchmark::DoNotOptimize(resolver.resolve(std::move(owned), "root"));
+        } else {
+            benchmark::DoNotOptimize(resolver.resolve(owned, "root"));
+        }
+        state.PauseTiming();
+        owned.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ResolveOwnedMap)
+    ->ArgNames({"documents", "consume"})
+    ->ArgsProduct({{64, 512}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+// The same, looking fragments up in a flat hash table instead of the map
+void BM_ResolveFromTable(benchmark::State& state) {
+    FragmentTable fragments(make_catalogue(static_cast<size_t>(state.range(0))));
+    JsonResolver resolver;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(resolver.resolve(fragments, "root"));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ResolveFromTable)->RangeMultiplier(8)->Range(64, 8192)->Unit(benchmark::kMicrosecond);
+
+// Evaluation alone, against a precompiled set, with either engine
+void BM_ResolveCompiled(benchmark::State& state) {
+    JsonResolverConfig config;
+    config.engine = state.range(1)
+        ? JsonResolverConfig::EvaluationEngine::Bytecode
+        : JsonResolverConfig::EvaluationEngine::Tree;
+    auto compiled = CompiledFragmentSet::compile(
+        make_catalogue(static_cast<size_t>(state.range(0))), config);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(compiled.resolve("root"));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ResolveCompiled)
+    ->ArgNames({"fragments", "bytecode"})
+    ->ArgsProduct({{64, 512, 4096, 8192}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+// A point read through several layers of references, against a full resolve
+void BM_ResolveAtPointer(benchmark::State& state) {
+    auto compiled = CompiledFragmentSet::compile(make_catalogue(static_cast<size_t>(state.range(0))));
+    const nlohmann::json::json_pointer pointer("/0/refs/0/refs/0/label");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(compiled.resolve_at("root", pointer));
+    }
+}
+BENCHMARK(BM_ResolveAtPointer)->RangeMultiplier(8)->Range(64, 8192)->Unit(benchmark::kMicrosecond);
+
+// Repeated resolves of one start fragment answered by a result cache
+void BM_ResolveCachedResult(benchmark::State& state) {
+    JsonResolverConfig config;
+    config.result_cache = std::make_shared<ResolveResultCache>(16);
+    auto compiled = CompiledFragmentSet::compile(
+        make_catalogue(static_cast<size_t>(state.range(0))), config);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(compiled.resolve_shared("root"));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ResolveCachedResult)->RangeMultiplier(8)->Range(64, 8192)->Unit(benchmark::kMicrosecond);
+
+// Building the document and dumping it, against streaming it directly
+void BM_ResolveAndDump(benchmark::State& state) {
+    auto compiled = CompiledFragmentSet::compile(make_catalogue(static_cast<size_t>(state.range(0))));
+    for (auto _ : state) {
+        std::ostringstream out;
+        out << compiled.resolve("root").dump();
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ResolveAndDump)->RangeMultiplier(8)->Range(64, 8192)->Unit(benchmark::kMicrosecond);
+
+void BM_ResolveToStream(benchmark::State& state) {
+    auto compiled = CompiledFragmentSet::compile(make_catalogue(static_cast<size_t>(state.range(0))));
+    for (auto _ : state) {
+        std::ostringstream out;
+        compiled.resolve_to("root", out);
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ResolveToStream)->RangeMultiplier(8)->Range(64, 8192)->Unit(benchmark::kMicrosecond);
+
+void BM_DeepChain(benchmark::State& state) {
+    auto fragments = make_chain(static_cast<size_t>(state.range(0)));
+    JsonResolver resolver;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(resolver.resolve(fragments, "chain0"));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DeepChain)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
+
+void BM_FanOut(benchmark::State& state) {
+    auto compiled = CompiledFragmentSet::compile(make_fan_out(static_cast<size_t>(state.range(0))));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(compiled.resolve("root"));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FanOut)->RangeMultiplier(8)->Range(8, 32768)->Unit(benchmark::kMicrosecond);
+
+void BM_TemplatePlaceholders(benchmark::State& state) {
+    JsonResolverConfig config;
+    config.template_expansion = state.range(1)
+        ? JsonResolverConfig::TemplateExpansion::Nested
+        : JsonResolverConfig::TemplateExpansion::SinglePass;
+    auto compiled = CompiledFragmentSet::compile(
+        make_template(static_cast<size_t>(state.range(0))), config);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(compiled.resolve("template"));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TemplatePlaceholders)
+    ->ArgNames({"placeholders", "nested"})
+    ->ArgsProduct({{1, 10, 100, 1000}, {0, 1}});
+
+void BM_DynamicKeys(benchmark::State& state) {
+    auto compiled = CompiledFragmentSet::compile(make_dynamic_keys(static_cast<size_t>(state.range(0))));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(compiled.resolve("object"));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DynamicKeys)->RangeMultiplier(8)->Range(8, 4096)->Unit(benchmark::kMicrosecond);
+
+void BM_StaticKeys(benchmark::State& state) {
+    auto compiled = CompiledFragmentSet::compile(make_static_keys(static_cast<size_t>(state.range(0))));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(compiled.resolve("object"));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StaticKeys)->RangeMultiplier(8)->Range(8, 4096)->Unit(benchmark::kMicrosecond);
+
+// One-shot Tarjan check over a layered graph with fan-out 4
+void BM_DependencyTrackerCycleCheck(benchmark::State& state) {
+    const auto count = static_cast<FragmentId>(state.range(0));
+    SymbolTable symbols;
+    for (FragmentId i = 0; i < count; ++i) {
+        symbols.intern(fragment_name("f", i));
+    }
+    DependencyTracker tracker(symbols);
+    for (FragmentId i = 0; i < count; ++i) {
+        for (FragmentId r = 1; r <= 4 && i + r * 7 < count; ++r) {
+            tracker.add_dependency(i, i + r * 7);
+        }
+    }
+    for (auto _ : state) {
+        tracker.check_for_cycles();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DependencyTrackerCycleCheck)->RangeMultiplier(8)->Range(64, 262144)->Unit(benchmark::kMicrosecond);
+
+// Rejecting reference-free strings, the common case when parsing. Text is
+// full of the first delimiter character so two-character delimiters show
+// the cost of false starts; range(1) selects std::string_view::find.
+void BM_DelimiterScan(benchmark::State& state) {
+    std::string text;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        text += "{a: b} "[i % 7];
+    }
+    const bool standard = state.range(1);
+    for (auto _ : state) {
+        for (std::string_view delimiter : {"[", "{{"}) {
+            benchmark::DoNotOptimize(standard
+                ? std::string_view(text).find(delimiter)
+                : DelimiterScanner::find(text, delimiter));
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * 2);
+}
+BENCHMARK(BM_DelimiterScan)->ArgsProduct({{16, 256, 4096}, {0, 1}});
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <random>
+#include <string>
+#include <nlohmann/json.hpp>
+
+namespace json_fragments {
+namespace bench {
+
+using FragmentMap = std::map<std::string, nlohmann::json>;
+
+inline std::string fragment_name(const std::string& prefix, size_t i) {
+    return prefix + std::to_string(i);
+}
+
+// chain0 -> chain1 -> ... -> chain<depth>, each link wrapping the next
+inline FragmentMap make_chain(size_t depth) {
+    FragmentMap fragments;
+    for (size_t i = 0; i < depth; ++i) {
+        fragments[fragment_name("chain", i)] = {
+            {"level", i},
+            {"next", "[" + fragment_name("chain", i + 1) + "]"}
+        };
+    }
+    fragments[fragment_name("chain", depth)] = {{"level", depth}, {"next", nullptr}};
+    return fragments;
+}
+
+// "root" lists width fragments that all include the same "base" fragment
+inline FragmentMap make_fan_out(size_t width) {
+    FragmentMap fragments;
+    fragments["base"] = {
+        {"region", "eu-west"},
+        {"limits", {{"cpu", 4}, {"memory", "16Gi"}}},
+        {"tags", nlohmann::json::array({"a", "b", "c"})}
+    };
+    nlohmann::json root = nlohmann::json::array();
+    for (size_t i = 0; i < width; ++i) {
+        std::string name = fragment_name("leaf", i);
+        fragments[name] = {{"id", i}, {"base", "[base]"}};
+        root.push_back("[" + name + "]");
+    }
+    fragments["root"] = root;
+    return fragments;
+}
+
+// "template" is one string with the given number of placeholders
+inline FragmentMap make_template(size_t placeholders) {
+    FragmentMap fragments;
+    std::string text = "https://example.com";
+    for (size_t i = 0; i < placeholders; ++i) {
+        std::string name = fragment_name("p", i);
+        fragments[name] = "segment" + std::to_string(i);
+        text += "/[" + name + "]";
+    }
+    fragments["template"] = text + "?v=1";
+    return fragments;
+}
+
+// "object" has the given number of entries whose keys and values are both
+// references
+inline FragmentMap make_dynamic_keys(size_t keys) {
+    FragmentMap fragments;
+    nlohmann::json object = nlohmann::json::object();
+    for (size_t i = 0; i < keys; ++i) {
+        std::string key = fragment_name("key", i);
+        std::string value = fragment_name("value", i);
+        fragments[key] = "field_" + std::to_string(i);
+        fragments[value] = static_cast<double>(i) / 10.0;
+        object["[" + key + "]"] = "[" + value + "]";
+    }
+    fragments["object"] = object;
+    return fragments;
+}
+
+// "object" has the given number of entries with literal keys whose values
+// are references
+inline FragmentMap make_static_keys(size_t keys) {
+    FragmentMap fragments;
+    nlohmann::json object = nlohmann::json::object();
+    for (size_t i = 0; i < keys; ++i) {
+        std::string value = fragment_name("value", i);
+        fragments[value] = static_cast<double>(i) / 10.0;
+        object["field_" + std::to_string(i)] = "[" + value + "]";
+    }
+    fragments["object"] = object;
+    return fragments;
+}
+
+// "root" lists count documents that each carry a reference-free body of
+// about payload bytes and refer to one shared author
+inline FragmentMap make_documents(size_t count, size_t payload) {
+    FragmentMap fragments;
+    fragments["author"] = {{"name", "Ada"}};
+    nlohmann::json root = nlohmann::json::array();
+    for (size_t i = 0; i < count; ++i) {
+        std::string name = fragment_name("doc", i);
+        fragments[name] = {
+            {"author", "[author]"},
+            {"body", {{"text", std::string(payload, 'x')}, {"tags", {"a", "b", "c"}}}}
+        };
+        root.push_back("[" + name + "]");
+    }
+    fragments["root"] = root;
+    return fragments;
+}
+
+// A catalogue of count fragments in layers, each referencing up to fan_out
+// fragments of the next layer. template_density of the references are
+// template placeholders that name the target's string label, mixed evenly
+// with whole references to the target. "root" references every fragment of
+// the first layer.
+inline FragmentMap make_layered_catalogue(
+    size_t count,
+    size_t layers,
+    size_t fan_out,
+    double template_density,
+    unsigned seed = 42
+) {
+    FragmentMap fragments;
+    std::mt19937 rng(seed);
+    const size_t layer_size = std::max<size_t>(1, count / std::max<size_t>(1, layers));
+
+    for (size_t i = 0; i < count; ++i) {
+        size_t next_layer = (i / layer_size + 1) * layer_size;
+        nlohmann::json fragment = {
+            {"id", i},
+            {"enabled", i % 3 != 0},
+            {"label", "[" + fragment_name("label", i) + "]"}
+        };
+        if (next_layer < count) {
+            std::uniform_int_distribution<size_t> pick(next_layer, std::min(count, next_layer + layer_size) - 1);
+            nlohmann::json refs = nlohmann::json::array();
+            for (size_t r = 0; r < fan_out; ++r) {
+                size_t target = pick(rng);
+                // Reference r is a template when it carries the running
+                // share of templates past a whole number
+                bool is_template = static_cast<size_t>((r + 1) * template_density) >
+                                   static_cast<size_t>(r * template_density);
+                if (!is_template) {
+                    refs.push_back("[" + fragment_name("f", target) + "]");
+                } else {
+                    refs.push_back("see [" + fragment_name("label", target) + "] for details");
+                }
+            }
+            fragment["refs"] = refs;
+        }
+        fragments[fragment_name("f", i)] = fragment;
+        fragments[fragment_name("label", i)] = "fragment " + std::to_string(i);
+    }
+
+    nlohmann::json root = nlohmann::json::array();
+    for (size_t i = 0; i < std::min(count, layer_size); ++i) {
+        root.push_back("[" + fragment_name("f", i) + "]");
+    }
+    fragments["root"] = root;
+    return fragments;
+}
+
+// Eight layers, alternating whole references with template placeholders
+inline FragmentMap make_catalogue(size_t count, size_t fan_out = 2, unsigned seed = 42) {
+    return make_layered_catalogue(count, 8, fan_out, 0.5, seed);
+}
+
+} // namespace bench
+} // namespace json_fragments
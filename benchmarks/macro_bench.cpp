@@ -0,0 +1,314 @@
+// Scaling benchmark over large synthetic catalogues. Unlike the Google
+// Benchmark micro benchmarks, each phase runs once per catalogue size, so
+// catalogues of a million fragments stay affordable, and the results are
+// written as one JSON report that a later build can be compared against:
+//
+//   json_fragments_macro_bench --fragments=1000,100000 --threads=4 --out=run.json
+//   json_fragments_macro_bench --baseline=run.json --tolerance=0.2
+//
+// With --baseline, the run exits non-zero if any phase's throughput fell by
+// more than the tolerance.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "allocation_counter.hpp"
+#include "fragment_generators.hpp"
+
+using namespace json_fragments;
+using namespace json_fragments::bench;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    std::vector<size_t> fragments = {1000, 10000, 100000};
+    size_t layers = 8;
+    size_t fan_out = 2;
+    double template_density = 0.5;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t resolves = 2000;
+    unsigned seed = 42;
+    std::string out;
+    std::string baseline;
+    double tolerance = 0.2;
+};
+
+[[noreturn]] void usage(const std::string& problem) {
+    std::cerr << problem << "\n"
+              << "usage: json_fragments_macro_bench [--fragments=N,N,...] [--layers=N] [--fan-out=N]\n"
+              << "       [--template-density=X] [--threads=N] [--resolves=N] [--seed=N]\n"
+              << "       [--out=FILE] [--baseline=FILE] [--tolerance=X]\n";
+    std::exit(2);
+}
+
+std::vector<size_t> parse_counts(const std::string& text) {
+    std::vector<size_t> counts;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = std::min(text.find(',', start), text.size());
+        counts.push_back(std::stoul(text.substr(start, comma - start)));
+        start = comma + 1;
+    }
+    return counts;
+}
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || equals == std::string::npos) usage("unexpected argument " + arg);
+        std::string name = arg.substr(2, equals - 2);
+        std::string value = arg.substr(equals + 1);
+        try {
+            if (name == "fragments") options.fragments = parse_counts(value);
+            else if (name == "layers") options.layers = std::stoul(value);
+            else if (name == "fan-out") options.fan_out = std::stoul(value);
+            else if (name == "template-density") options.template_density = std::stod(value);
+            else if (name == "threads") options.threads = std::stoul(value);
+            else if (name == "resolves") options.resolves = std::stoul(value);
+            else if (name == "seed") options.seed = static_cast<unsigned>(std::stoul(value));
+            else if (name == "out") options.out = value;
+            else if (name == "baseline") options.baseline = value;
+            else if (name == "tolerance") options.tolerance = std::stod(value);
+            else usage("unknown option --" + name);
+        } catch (const std::logic_error&) {
+            usage("bad value for --" + name);
+        }
+    }
+    if (options.layers == 0 || options.threads == 0 || options.resolves == 0) {
+        usage("--layers, --threads and --resolves must be positive");
+    }
+    return options;
+}
+
+// Peak resident set size of the process so far, in kilobytes
+long peak_rss_kb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+double seconds_since(Clock::time_point started) {
+    return std::chrono::duration<double>(Clock::now() - started).count();
+}
+
+// Fills in throughput and latency percentiles from per-resolve latencies
+void add_latencies(json& run, std::vector<double>& latencies, double wall_seconds) {
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double q) {
+        size_t index = std::min(latencies.size() - 1, static_cast<size_t>(q * latencies.size()));
+        return latencies[index] * 1e6;
+    };
+    run["resolves"] = latencies.size();
+    run["seconds"] = wall_seconds;
+    run["throughput"] = latencies.size() / wall_seconds;
+    run["unit"] = "resolves/s";
+    run["p50_us"] = percentile(0.50);
+    run["p99_us"] = percentile(0.99);
+    run["max_us"] = latencies.back() * 1e6;
+}
+
+class CatalogueRun {
+public:
+    CatalogueRun(const Options& options, size_t count)
+        : options_(options)
+        , count_(count)
+        , fragments_(make_layered_catalogue(count, options.layers, options.fan_out,
+                                            options.template_density, options.seed)) {
+        // Starts are drawn from the first layer, so each resolve walks a
+        // subtree of every layer below it
+        size_t layer_size = std::max<size_t>(1, count / options.layers);
+        std::mt19937 rng(options.seed);
+        std::uniform_int_distribution<size_t> pick(0, std::min(count, layer_size) - 1);
+        for (size_t i = 0; i < options.resolves; ++i) {
+            starts_.push_back(fragment_name("f", pick(rng)));
+        }
+    }
+
+    void run(json& runs) {
+        runs.push_back(compile(nullptr));
+        if (options_.threads > 1) {
+            ThreadPool pool(options_.threads);
+            runs.push_back(compile(&pool));
+        }
+
+        auto compiled = CompiledFragmentSet::compile(fragments_);
+        runs.push_back(resolve_serially("resolve_compiled", [&](const std::string& start) {
+            return compiled.resolve(start);
+        }));
+        if (options_.threads > 1) {
+            runs.push_back(resolve_concurrently("resolve_compiled", compiled));
+        }
+
+        JsonResolver resolver;
+        runs.push_back(resolve_serially("resolve_uncompiled", [&](const std::string& start) {
+            return resolver.resolve(fragments_, start);
+        }));
+    }
+
+private:
+    json describe(const std::string& phase, size_t threads) const {
+        return {{"fragments", count_}, {"phase", phase}, {"threads", threads}};
+    }
+
+    json compile(ThreadPool* pool) const {
+        auto started = Clock::now();
+        auto compiled = CompiledFragmentSet::compile(fragments_, {}, pool);
+        double elapsed = seconds_since(started);
+
+        json run = describe("compile", pool ? pool->size() : 1);
+        run["seconds"] = elapsed;
+        run["throughput"] = fragments_.size() / elapsed;
+        run["unit"] = "fragments/s";
+        run["peak_rss_kb"] = peak_rss_kb();
+        return run;
+    }
+
+    template<typename Resolve>
+    json resolve_serially(const std::string& phase, Resolve&& resolve) const {
+        std::vector<double> latencies;
+        latencies.reserve(starts_.size());
+        size_t allocated_before = allocation_count();
+        auto started = Clock::now();
+        for (const auto& start : starts_) {
+            auto resolve_started = Clock::now();
+            json result = resolve(start);
+            latencies.push_back(seconds_since(resolve_started));
+        }
+        double elapsed = seconds_since(started);
+        // The latencies vector was reserved up front, so every counted
+        // allocation belongs to a resolve
+        size_t allocated = allocation_count() - allocated_before;
+
+        json run = describe(phase, 1);
+        add_latencies(run, latencies, elapsed);
+        run["allocations_per_resolve"] = static_cast<double>(allocated) / starts_.size();
+        run["peak_rss_kb"] = peak_rss_kb();
+        return run;
+    }
+
+    // Every thread resolves its own share of the starts against one
+    // compiled set
+    json resolve_concurrently(const std::string& phase, const CompiledFragmentSet& compiled) const {
+        size_t threads = options_.threads;
+        std::vector<std::vector<double>> latencies(threads);
+        std::vector<std::thread> workers;
+        size_t allocated_before = allocation_count();
+        auto started = Clock::now();
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                for (size_t i = t; i < starts_.size(); i += threads) {
+                    auto resolve_started = Clock::now();
+                    json result = compiled.resolve(starts_[i]);
+                    latencies[t].push_back(seconds_since(resolve_started));
+                }
+            });
+        }
+        for (auto& worker : workers) worker.join();
+        double elapsed = seconds_since(started);
+        size_t allocated = allocation_count() - allocated_before;
+
+        std::vector<double> merged;
+        for (const auto& thread_latencies : latencies) {
+            merged.insert(merged.end(), thread_latencies.begin(), thread_latencies.end());
+        }
+        json run = describe(phase, threads);
+        add_latencies(run, merged, elapsed);
+        // Includes the threads and their latency vectors, a small share of
+        // the total at any useful number of resolves
+        run["allocations_per_resolve"] = static_cast<double>(allocated) / starts_.size();
+        run["peak_rss_kb"] = peak_rss_kb();
+        return run;
+    }
+
+    const Options& options_;
+    size_t count_;
+    FragmentMap fragments_;
+    std::vector<std::string> starts_;
+};
+
+// Lists the phases whose throughput fell by more than the tolerance from
+// the baseline; phases missing from either report are not compared
+std::vector<std::string> find_regressions(const json& runs, const json& baseline, double tolerance) {
+    std::vector<std::string> regressions;
+    for (const auto& run : runs) {
+        for (const auto& previous : baseline.at("runs")) {
+            if (previous.at("fragments") != run.at("fragments") || previous.at("phase") != run.at("phase") ||
+                previous.at("threads") != run.at("threads")) {
+                continue;
+            }
+            double before = previous.at("throughput").get<double>();
+            double now = run.at("throughput").get<double>();
+            if (now < before * (1.0 - tolerance)) {
+                char line[160];
+                std::snprintf(line, sizeof(line), "%s, %zu fragments, %zu threads: %.0f -> %.0f %s",
+                              run.at("phase").get<std::string>().c_str(), run.at("fragments").get<size_t>(),
+                              run.at("threads").get<size_t>(), before, now,
+                              run.at("unit").get<std::string>().c_str());
+                regressions.push_back(line);
+            }
+        }
+    }
+    return regressions;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options = parse_options(argc, argv);
+
+    json runs = json::array();
+    for (size_t count : options.fragments) {
+        std::cerr << "catalogue of " << count << " fragments\n";
+        CatalogueRun(options, count).run(runs);
+    }
+
+    json report = {
+        {"config", {
+            {"fragments", options.fragments},
+            {"layers", options.layers},
+            {"fan_out", options.fan_out},
+            {"template_density", options.template_density},
+            {"threads", options.threads},
+            {"resolves", options.resolves},
+            {"seed", options.seed}
+        }},
+        {"runs", runs}
+    };
+
+    if (options.out.empty()) {
+        std::cout << report.dump(2) << "\n";
+    } else {
+        std::ofstream out(options.out);
+        out << report.dump(2) << "\n";
+        if (!out) {
+            std::cerr << "cannot write " << options.out << "\n";
+            return 2;
+        }
+    }
+
+    if (options.baseline.empty()) return 0;
+    std::ifstream in(options.baseline);
+    if (!in) {
+        std::cerr << "cannot read " << options.baseline << "\n";
+        return 2;
+    }
+    auto regressions = find_regressions(runs, json::parse(in), options.tolerance);
+    for (const auto& regression : regressions) {
+        std::cerr << "regression: " << regression << "\n";
+    }
+    return regressions.empty() ? 0 : 1;
+}
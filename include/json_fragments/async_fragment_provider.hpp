@@ -0,0 +1,31 @@
+#pragma once
+
+#include <future>
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace json_fragments {
+
+// Fetches fragments from a store that answers asynchronously, such as a
+// remote key-value service. JsonResolver::resolve_async asks for each batch
+// of names as soon as parsing discovers them, so a provider that issues a
+// batch's fetches concurrently overlaps them with parsing and with the
+// batches still in flight.
+class AsyncFragmentProvider {
+public:
+    virtual ~AsyncFragmentProvider() = default;
+
+    // Starts fetching a batch of fragments and returns at once, with one
+    // future per name in the same order. A fragment that does not exist
+    // yields std::nullopt; an exception stored in a future fails the
+    // resolve. Called from the resolving thread only. A resolve that runs
+    // out of time destroys the futures still pending, so futures that
+    // block in their destructor, as std::async's do, hold it up until
+    // their fetch ends.
+    virtual std::vector<std::future<std::optional<nlohmann::json>>>
+    fetch(const std::vector<std::string>& names) = 0;
+};
+
+} // namespace json_fragments
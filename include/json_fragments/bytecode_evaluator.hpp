@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "fragment_nodes.hpp"
+#include "fragment_implementations.hpp"
+#include "node_arena.hpp"
+
+namespace json_fragments {
+
+// One step of a compiled fragment program. Programs run on a stack of
+// values: containers are opened on the stack, their children are pushed on
+// top of them and folded in, so a finished program leaves one value.
+struct Instruction {
+    enum class Opcode : uint8_t {
+        PushLiteral,      // Push a copy of literal, or move it in a consuming resolve
+        PushReference,    // Push the resolved fragment operand named by name
+        ExpandTemplate,   // Push the expansion of string_template
+        BeginObject,      // Push an empty object
+        LiteralKey,       // Start an entry whose key is name
+        ComputedKey,      // Pop a value and start an entry using it as key
+        EndEntry,         // Pop a value into the object under the current key
+        BeginArray,       // Push an empty array with room for operand elements
+        BeginElement,     // Start element operand of the array
+        EndElement        // Pop a value onto the end of the array
+    };
+
+    Opcode op;
+    uint32_t operand = 0;
+    union {
+        const nlohmann::json* literal;
+        const std::string* name;
+        const StringTemplateNode* string_template;
+    };
+};
+
+// A fragment compiled to a flat instruction array and run by a single
+// interpreter loop instead of a virtual call per node. It is a node itself,
+// so it slots into CompiledFragments in place of the tree it was compiled
+// from. Templates are expanded by their tree node, and containers are always
+// evaluated sequentially.
+class BytecodeNode : public FragmentNode {
+    ArenaArray<Instruction> program_;
+    FragmentNodePtr tree_;
+
+public:
+    // The program, and the tree nodes it refers to, must outlive the node
+    BytecodeNode(ArenaArray<Instruction> program, FragmentNodePtr tree)
+        : program_(program)
+        , tree_(tree) {}
+
+    nlohmann::json evaluate(
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context
+    ) const override {
+        using Opcode = Instruction::Opcode;
+
+        std::vector<nlohmann::json>& stack = context.value_stack();
+        // Literal keys point into the program; computed ones are owned by
+        // computed_keys until their entry ends
+        std::vector<const std::string*>& keys = context.key_stack();
+        std::deque<std::string>& computed_keys = context.computed_keys();
+
+        // Unwinds whatever an exception leaves on the context's stacks
+        struct Unwind {
+            EvaluationContext& context;
+            size_t path, values, keys, computed_keys;
+            ~Unwind() {
+                while (context.path_depth() > path) context.pop();
+                context.value_stack().resize(values);
+                context.key_stack().resize(keys);
+                context.computed_keys().resize(computed_keys);
+            }
+        } unwind{context, context.path_depth(), stack.size(), keys.size(), computed_keys.size()};
+
+        for (const Instruction& instruction : program_) {
+            switch (instruction.op) {
+                case Opcode::PushLiteral:
+                    if (ResolveBudget* budget = context.budget()) budget->add_copy(*instruction.literal);
+                    if (context.consumes_literals()) {
+                        // As in LiteralNode, the resolve owns the value
+                        stack.push_back(std::move(*const_cast<nlohmann::json*>(instruction.literal)));
+                    } else {
+                        stack.push_back(*instruction.literal);
+                    }
+                    break;
+
+                case Opcode::PushReference: {
+                    const std::string& name = *instruction.name;
+                    EvaluationContext::ScopedComponent path_component(context, name);
+                    if (const FragmentNode* node = context.single_use_node(instruction.operand)) {
+                        stack.push_back(context.evaluate_single_use(
+                            instruction.operand, *node, fragments, config));
+                        break;
+                    }
+                    const nlohmann::json* value =
+                        context.resolve_fragment(instruction.operand, fragments, config);
+                    if (value) {
+                        if (ResolveStats* stats = context.stats()) ++stats->value_copies;
+                        if (ResolveBudget* budget = context.budget()) budget->add_copy(*value);
+                        stack.push_back(*value);
+                    } else {
+                        stack.push_back(ReferenceNode::missing_value(name, config));
+                    }
+                    break;
+                }
+
+                case Opcode::ExpandTemplate:
+                    stack.push_back(instruction.string_template->StringTemplateNode::evaluate(
+                        fragments, config, context));
+                    break;
+
+                case Opcode::BeginObject:
+                    // Matches ObjectNode, which yields null for an empty object
+                    stack.emplace_back();
+                    break;
+
+                case Opcode::LiteralKey:
+                    keys.push_back(instruction.name);
+                    context.push(*instruction.name);
+                    break;
+
+                case Opcode::ComputedKey: {
+                    if (!stack.back().is_string()) {
+                        throw InvalidKeyError("Object key must evaluate to string");
+                    }
+                    computed_keys.push_back(std::move(stack.back().get_ref<std::string&>()));
+                    stack.pop_back();
+                    keys.push_back(&computed_keys.back());
+                    context.push(computed_keys.back());
+                    break;
+                }
+
+                case Opcode::EndEntry: {
+                    nlohmann::json value = std::move(stack.back());
+                    stack.pop_back();
+                    stack.back()[*keys.back()] = std::move(value);
+                    if (!computed_keys.empty() && keys.back() == &computed_keys.back()) {
+                        computed_keys.pop_back();
+                    }
+                    keys.pop_back();
+                    context.pop();
+                    break;
+                }
+
+                case Opcode::BeginArray:
+                    stack.push_back(nlohmann::json::array());
+                    stack.back().get_ref<nlohmann::json::array_t&>().reserve(instruction.operand);
+                    break;
+
+                case Opcode::BeginElement:
+                    context.push_index(instruction.operand);
+                    break;
+
+                case Opcode::EndElement: {
+                    nlohmann::json value = std::move(stack.back());
+                    stack.pop_back();
+                    stack.back().get_ref<nlohmann::json::array_t&>().push_back(std::move(value));
+                    context.pop();
+                    break;
+                }
+            }
+        }
+
+        nlohmann::json result = std::move(stack.back());
+        stack.pop_back();
+        return result;
+    }
+
+    // Streaming walks the tree the program was compiled from
+    void write(
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context,
+        JsonWriter& writer
+    ) const override {
+        tree_->write(fragments, config, context, writer);
+    }
+
+    // So does descending along a pointer, evaluating only the path
+    nlohmann::json evaluate_at(
+        const PointerPath& path,
+        size_t depth,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context
+    ) const override {
+        return tree_->evaluate_at(path, depth, fragments, config, context);
+    }
+
+    // Visitors see the tree the program was compiled from
+    void accept(FragmentVisitor& visitor) override {
+        tree_->accept(visitor);
+    }
+
+    ArenaArray<const Instruction> program() const { return {program_.begin(), program_.size()}; }
+    FragmentNodePtr tree() const { return tree_; }
+};
+
+// Compiles a fragment tree into a BytecodeNode by walking it in evaluation
+// order
+class BytecodeCompiler : public FragmentVisitor {
+    std::vector<Instruction> program_;
+
+public:
+    // Compiles a tree into a program stored in the tree's arena
+    static BytecodeNode* compile(FragmentNodePtr tree, NodeArena& arena) {
+        BytecodeCompiler compiler;
+        tree->accept(compiler);
+
+        auto program = arena.make_array<Instruction>(compiler.program_.size());
+        std::copy(compiler.program_.begin(), compiler.program_.end(), program.begin());
+        return arena.create<BytecodeNode>(program, tree);
+    }
+
+    void visit(LiteralNode& node) override {
+        emit(Instruction::Opcode::PushLiteral).literal = &node.value();
+    }
+
+    void visit(ReferenceNode& node) override {
+        emit(Instruction::Opcode::PushReference, node.fragment_id()).name = &node.fragment_name();
+    }
+
+    void visit(StringTemplateNode& node) override {
+        emit(Instruction::Opcode::ExpandTemplate).string_template = &node;
+    }
+
+    void visit(ObjectNode& node) override {
+        emit(Instruction::Opcode::BeginObject);
+        for (const auto& [key, value] : node.entries()) {
+            // Keys that are literal strings skip the value stack
+            auto* literal = dynamic_cast<LiteralNode*>(key);
+            if (literal && literal->value().is_string()) {
+                emit(Instruction::Opcode::LiteralKey).name =
+                    &literal->value().get_ref<const std::string&>();
+            } else {
+                key->accept(*this);
+                emit(Instruction::Opcode::ComputedKey);
+            }
+            value->accept(*this);
+            emit(Instruction::Opcode::EndEntry);
+        }
+    }
+
+    void visit(ArrayNode& node) override {
+        auto elements = node.elements();
+        emit(Instruction::Opcode::BeginArray, static_cast<uint32_t>(elements.size()));
+        for (size_t i = 0; i < elements.size(); ++i) {
+            emit(Instruction::Opcode::BeginElement, static_cast<uint32_t>(i));
+            elements[i]->accept(*this);
+            emit(Instruction::Opcode::EndElement);
+        }
+    }
+
+private:
+    // Appends an instruction, returning it so the caller can set its pointer
+    Instruction& emit(Instruction::Opcode op, uint32_t operand = 0) {
+        Instruction& instruction = program_.emplace_back();
+        instruction.op = op;
+        instruction.operand = operand;
+        instruction.literal = nullptr;
+        return instruction;
+    }
+};
+
+} // namespace json_fragments
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "fragment_graph.hpp"
+#include "fragment_nodes.hpp"
+#include "resolve_result_cache.hpp"
+#include "thread_pool.hpp"
+
+namespace json_fragments {
+
+// An immutable, pre-parsed set of fragments. Every fragment is parsed into a
+// node tree and checked for circular dependencies once, when the set is
+// compiled; resolve() then only evaluates the prebuilt trees. resolve() keeps
+// all of its state on the stack, so one set can serve many threads at once.
+class CompiledFragmentSet {
+public:
+    // Parses every fragment in the set. Throws CircularDependencyError if any
+    // fragment depends on itself, directly or transitively. With a pool,
+    // fragments are parsed on its threads and the graph is checked for
+    // cycles once they are all parsed.
+    static CompiledFragmentSet compile(
+        std::map<std::string, nlohmann::json> fragments,
+        JsonResolverConfig config = {},
+        ThreadPool* pool = nullptr
+    );
+
+    // Maps a plan written by save() back into memory. Names, template
+    // pieces and string literals are read straight from the mapping; other
+    // literals are parsed from their JSON text, and the node trees are
+    // rebuilt. Templates are not re-parsed, but the reference graph is
+    // checked for cycles again. The plan's delimiters must match config's.
+    // Throws PlanFormatError if the plan is corrupt, cyclic, nested too
+    // deeply or incompatible.
+    static CompiledFragmentSet load(const std::string& path, JsonResolverConfig config = {});
+
+    CompiledFragmentSet(CompiledFragmentSet&&) noexcept;
+    CompiledFragmentSet& operator=(CompiledFragmentSet&&) noexcept;
+    ~CompiledFragmentSet();
+
+    // Resolves a fragment and all its dependencies against the compiled set.
+    // Work done by the call is added to stats if given; parsing happened at
+    // compile time, so only evaluation is counted.
+    nlohmann::json resolve(const std::string& start_fragment, ResolveStats* stats = nullptr) const;
+
+    // Resolves a fragment into a shared, immutable result. With a result
+    // cache in the config, a start fragment resolved before is returned
+    // from the cache without evaluating anything, and resolve() copies it.
+    ResolvedFragmentPtr resolve_shared(
+        const std::string& start_fragment,
+        ResolveStats* stats = nullptr
+    ) const;
+
+    // Resolves only the value a JSON pointer names inside a start
+    // fragment's document, evaluating the nodes on the pointer's path and
+    // the subtree it ends at. Throws PointerNotFoundError if the pointer
+    // leads nowhere. Both engines descend along the pointer through
+    // referenced fragments.
+    nlohmann::json resolve_at(
+        const std::string& start_fragment,
+        const nlohmann::json::json_pointer& pointer,
+        ResolveStats* stats = nullptr
+    ) const;
+
+    // Resolves a fragment and writes it to a stream as compact JSON while
+    // evaluating, producing the same text as resolve(start).dump() without
+    // building the whole document. Reference-free objects and arrays are
+    // written from text serialized at compile time. If resolving fails, the
+    // exception is thrown after part of the output may have been written.
+    void resolve_to(
+        const std::string& start_fragment,
+        std::ostream& out,
+        ResolveStats* stats = nullptr
+    ) const;
+
+    // Resolves several start fragments at once, returning results in the
+    // same order. Dependencies shared between starts are evaluated once per
+    // worker; with a pool, the starts are spread across its threads.
+    std::vector<nlohmann::json> resolve_many(
+        const std::vector<std::string>& start_fragments,
+        ThreadPool* pool = nullptr
+    ) const;
+
+    // Writes the compiled trees in a compact, versioned binary form that
+    // load() can map back without parsing the fragments again. Plans use
+    // the byte order of the machine that wrote them.
+    void save(std::ostream& out) const;
+
+    // The fragments of the set and the references between them. Pair it
+    // with a ResolveStats from resolve() to profile where time goes.
+    FragmentGraph dependency_graph() const { return FragmentGraph(compiled_); }
+
+    // Whether the set contains a fragment with the given name
+    bool contains(const std::string& fragment_name) const;
+
+    // Number of compiled fragments
+    size_t size() const { return size_; }
+
+    const JsonResolverConfig& config() const { return config_; }
+
+private:
+    CompiledFragmentSet(
+        std::map<std::string, nlohmann::json> fragments,
+        JsonResolverConfig config,
+        ThreadPool* pool
+    );
+
+    CompiledFragmentSet(
+        JsonResolverConfig config,
+        CompiledFragments compiled,
+        std::shared_ptr<const void> storage
+    );
+
+    nlohmann::json evaluate(const std::string& start_fragment, ResolveStats* stats) const;
+
+    JsonResolverConfig config_;
+    uint64_t generation_;       // Key of this set's entries in a result cache
+    size_t config_hash_;
+    std::map<std::string, nlohmann::json> fragments_;
+    CompiledFragments compiled_;
+    size_t size_ = 0;
+    std::shared_ptr<const void> storage_;  // Loaded plan the trees point into
+};
+
+} // namespace json_fragments
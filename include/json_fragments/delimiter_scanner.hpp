@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#if !defined(JSON_FRAGMENTS_DISABLE_SIMD)
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define JSON_FRAGMENTS_SIMD_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define JSON_FRAGMENTS_SIMD_NEON 1
+#endif
+#endif
+
+namespace json_fragments {
+
+// Finds delimiters in strings, returning the same positions as
+// std::string_view::find. Text up to the first occurrence of the
+// delimiter's first character is skipped with memchr. After that, blocks
+// of text are compared against the delimiter's first and last characters
+// at once, and only positions where both match are checked in full. The
+// block scan uses AVX2, SSE2 or NEON when the compiler targets them;
+// define JSON_FRAGMENTS_DISABLE_SIMD to use the scalar search instead.
+class DelimiterScanner {
+public:
+    static constexpr size_t npos = std::string_view::npos;
+
+    // Position of the first delimiter at or after pos, or npos
+    static size_t find(std::string_view text, std::string_view delimiter, size_t pos = 0) {
+        if (delimiter.empty() || pos > text.size() || delimiter.size() > text.size() - pos) {
+            return text.find(delimiter, pos);
+        }
+
+        // Skip to the first place the delimiter could start. The C library's
+        // memchr is vectorized and picks the widest instructions at run
+        // time, so text that never contains the first character is rejected
+        // as fast as the machine allows.
+        const char* data = text.data();
+        const size_t limit = text.size() - delimiter.size() + 1;
+        const void* first = std::memchr(data + pos, delimiter.front(), limit - pos);
+        if (!first) return npos;
+        pos = static_cast<size_t>(static_cast<const char*>(first) - data);
+        if (delimiter.size() == 1 || std::memcmp(data + pos, delimiter.data(), delimiter.size()) == 0) return pos;
+        ++pos;
+
+        // The first character occurs without the rest of the delimiter, and
+        // may be common; filter on the first and last characters together
+        // so false starts cost a block scan instead of a memchr call each
+#if defined(JSON_FRAGMENTS_SIMD_X86) && defined(__AVX2__)
+        if (scan_avx2(text, delimiter, pos)) return pos;
+#endif
+#if defined(JSON_FRAGMENTS_SIMD_X86)
+        if (scan_sse2(text, delimiter, pos)) return pos;
+#elif defined(JSON_FRAGMENTS_SIMD_NEON)
+        if (scan_neon(text, delimiter, pos)) return pos;
+#endif
+        // The tail, shorter than a block
+        return text.find(delimiter, pos);
+    }
+
+    // Whether the text contains the delimiter anywhere
+    static bool contains(std::string_view text, std::string_view delimiter) {
+        return find(text, delimiter) != npos;
+    }
+
+private:
+    // Whether the delimiter occurs at a position whose first and last
+    // characters are already known to match
+    static bool matches_at(const char* at, std::string_view delimiter) {
+        return delimiter.size() <= 2 ||
+               std::memcmp(at + 1, delimiter.data() + 1, delimiter.size() - 2) == 0;
+    }
+
+    static int lowest_bit(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    // Each scan advances pos block by block. It returns true with pos at
+    // the first match, or false with pos where fewer than a block of
+    // candidates remain, leaving those to the next, narrower scan.
+
+#if defined(JSON_FRAGMENTS_SIMD_X86) && defined(__AVX2__)
+    static bool scan_avx2(std::string_view text, std::string_view delimiter, size_t& pos) {
+        const size_t last = delimiter.size() - 1;
+        const __m256i first_char = _mm256_set1_epi8(delimiter.front());
+        const __m256i last_char = _mm256_set1_epi8(delimiter.back());
+        const char* data = text.data();
+        for (; pos + last + 32 <= text.size(); pos += 32) {
+            __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos + last));
+            auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(
+                _mm256_cmpeq_epi8(block_first, first_char),
+                _mm256_cmpeq_epi8(block_last, last_char))));
+            for (; mask; mask &= mask - 1) {
+                size_t candidate = pos + static_cast<size_t>(lowest_bit(mask));
+                if (matches_at(data + candidate, delimiter)) {
+                    pos = candidate;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+#endif
+
+#if defined(JSON_FRAGMENTS_SIMD_X86)
+    static bool scan_sse2(std::string_view text, std::string_view delimiter, size_t& pos) {
+        const size_t last = delimiter.size() - 1;
+        const __m128i first_char = _mm_set1_epi8(delimiter.front());
+        const __m128i last_char = _mm_set1_epi8(delimiter.back());
+        const char* data = text.data();
+        for (; pos + last + 16 <= text.size(); pos += 16) {
+            __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + last));
+            auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(
+                _mm_cmpeq_epi8(block_first, first_char),
+                _mm_cmpeq_epi8(block_last, last_char))));
+            for (; mask; mask &= mask - 1) {
+                size_t candidate = pos + static_cast<size_t>(lowest_bit(mask));
+                if (matches_at(data + candidate, delimiter)) {
+                    pos = candidate;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+#endif
+
+#if defined(JSON_FRAGMENTS_SIMD_NEON)
+    static bool scan_neon(std::string_view text, std::string_view delimiter, size_t& pos) {
+        const size_t last = delimiter.size() - 1;
+        const uint8x16_t first_char = vdupq_n_u8(static_cast<uint8_t>(delimiter.front()));
+        const uint8x16_t last_char = vdupq_n_u8(static_cast<uint8_t>(delimiter.back()));
+        const auto* data = reinterpret_cast<const uint8_t*>(text.data());
+        for (; pos + last + 16 <= text.size(); pos += 16) {
+            uint8x16_t both = vandq_u8(
+                vceqq_u8(vld1q_u8(data + pos), first_char),
+                vceqq_u8(vld1q_u8(data + pos + last), last_char));
+            // Narrow each byte to four bits, giving a 64-bit candidate mask
+            uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+                vshrn_n_u16(vreinterpretq_u16_u8(both), 4)), 0);
+            while (mask) {
+                int bit = __builtin_ctzll(mask);
+                size_t candidate = pos + static_cast<size_t>(bit / 4);
+                if (matches_at(text.data() + candidate, delimiter)) {
+                    pos = candidate;
+                    return true;
+                }
+                mask &= ~(uint64_t{0xF} << bit);
+            }
+        }
+        return false;
+    }
+#endif
+};
+
+} // namespace json_fragments
@@ -1,96 +1,316 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_set>
 #include <vector>
 #include "exceptions.hpp"
+#include "symbol_table.hpp"
 
 namespace json_fragments {
 
 class DependencyTracker {
 private:
-    std::map<std::string, std::set<std::string>> dependencies_;
-    std::set<std::string> currently_evaluating_;
+    static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+    // Fragment names are interned into dense IDs; edges are stored by ID
+    SymbolTable owned_symbols_;
+    SymbolTable& symbols_;
+    std::vector<std::vector<FragmentId>> edges_;
+    std::vector<std::vector<FragmentId>> dependents_;  // Reverse edges
+    std::unordered_set<uint64_t> edge_keys_;
+
+    // Fragments currently being evaluated, in evaluation order
+    std::vector<FragmentId> evaluation_stack_;
+    std::vector<bool> on_evaluation_stack_;
 
 public:
-    // Record a dependency and check for cycles
+    DependencyTracker() : symbols_(owned_symbols_) {}
+
+    // Track fragments by the IDs of an existing symbol table
+    explicit DependencyTracker(SymbolTable& symbols) : symbols_(symbols) {}
+
+    DependencyTracker(const DependencyTracker&) = delete;
+    DependencyTracker& operator=(const DependencyTracker&) = delete;
+
+    // Record a dependency without checking it. Recording is O(1); cycles are
+    // reported by begin_evaluation() while walking, or by check_for_cycles()
+    // once every edge is in.
+    void add_dependency(FragmentId dependent, FragmentId dependency) {
+        reserve(std::max(dependent, dependency));
+        if (edge_keys_.insert(edge_key(dependent, dependency)).second) {
+            edges_[dependent].push_back(dependency);
+            dependents_[dependency].push_back(dependent);
+        }
+    }
+
+    // Forget every dependency a fragment has, e.g. before re-parsing it
+    void clear_dependencies(FragmentId dependent) {
+        if (dependent >= edges_.size()) return;
+        for (FragmentId dependency : edges_[dependent]) {
+            edge_keys_.erase(edge_key(dependent, dependency));
+            auto& reverse = dependents_[dependency];
+            reverse.erase(std::find(reverse.begin(), reverse.end(), dependent));
+        }
+        edges_[dependent].clear();
+    }
+
+    // Record a dependency and check for cycles through it, throwing
+    // CircularDependencyError if the edge closes one. The edge stays
+    // recorded either way. Costs a walk of everything the dependent reaches;
+    // bulk loads should use the ID overload and check_for_cycles() instead.
     void add_dependency(const std::string& dependent, const std::string& dependency) {
         if (dependent.empty()) return;
+        FragmentId from = symbols_.intern(dependent);
+        add_dependency(from, symbols_.intern(dependency));
+        check_for_cycles_through(from);
+    }
 
-        // Add the dependency
-        dependencies_[dependent].insert(dependency);
-        
-        // Check for cycles after adding new dependency
-        std::set<std::string> visited;
-        std::vector<std::string> cycle_path;
-        if (has_cycle_from(dependent, visited, cycle_path)) {
-            throw CircularDependencyError(build_cycle_string(cycle_path));
+    // Start evaluating a fragment. Re-entering a fragment that is still being
+    // evaluated means the walk has followed a cycle back to it.
+    void begin_evaluation(FragmentId fragment) {
+        reserve(fragment);
+        if (on_evaluation_stack_[fragment]) {
+            auto first = std::find(evaluation_stack_.begin(), evaluation_stack_.end(), fragment);
+            throw CircularDependencyError(build_cycle_string(
+                std::vector<FragmentId>(first, evaluation_stack_.end())));
         }
+        evaluation_stack_.push_back(fragment);
+        on_evaluation_stack_[fragment] = true;
     }
 
-    // Start evaluating a fragment
     void begin_evaluation(const std::string& fragment_name) {
-        if (currently_evaluating_.find(fragment_name) != currently_evaluating_.end()) {
-            throw CircularDependencyError(build_cycle_string(
-                std::vector<std::string>(currently_evaluating_.begin(), 
-                                       currently_evaluating_.end())));
-        }
-        currently_evaluating_.insert(fragment_name);
+        begin_evaluation(symbols_.intern(fragment_name));
     }
 
     // End evaluating a fragment
+    void end_evaluation(FragmentId fragment) {
+        if (fragment >= on_evaluation_stack_.size() || !on_evaluation_stack_[fragment]) return;
+
+        on_evaluation_stack_[fragment] = false;
+        auto pos = std::find(evaluation_stack_.rbegin(), evaluation_stack_.rend(), fragment);
+        evaluation_stack_.erase(std::next(pos).base());
+    }
+
+    // Number of fragments currently being evaluated, one inside another
+    size_t evaluation_depth() const { return evaluation_stack_.size(); }
+
     void end_evaluation(const std::string& fragment_name) {
-        currently_evaluating_.erase(fragment_name);
+        FragmentId fragment = symbols_.find(fragment_name);
+        if (fragment != SymbolTable::npos) end_evaluation(fragment);
     }
 
-    // Access the dependency map (for debugging/testing)
-    const auto& get_dependencies() const { return dependencies_; }
+    // Checks the whole recorded graph for cycles in a single pass using
+    // Tarjan's strongly connected components algorithm
+    void check_for_cycles() const {
+        auto cycle = find_cycle();
+        if (!cycle.empty()) {
+            throw CircularDependencyError(build_cycle_string(cycle));
+        }
+    }
 
-private:
-    // Check for cycles in the dependency graph starting from a given node
-    bool has_cycle_from(const std::string& start, 
-                       std::set<std::string>& visited, 
-                       std::vector<std::string>& path) const {
-        if (std::find(path.begin(), path.end(), start) != path.end()) {
-            if (path.empty() || path.back() != start) {
-                path.push_back(start);
+    // Checks whether any path of dependencies leads from a fragment back to
+    // itself. Cheaper than check_for_cycles() when only that fragment's
+    // dependencies have changed, since any new cycle must pass through it.
+    void check_for_cycles_through(FragmentId fragment) const {
+        if (fragment >= edges_.size()) return;
+
+        std::vector<FragmentId> parent(edges_.size(), SymbolTable::npos);
+        std::vector<FragmentId> queue{fragment};
+        parent[fragment] = fragment;
+        for (size_t head = 0; head < queue.size(); ++head) {
+            FragmentId node = queue[head];
+            for (FragmentId next : edges_[node]) {
+                if (next == fragment) {
+                    std::vector<FragmentId> path;
+                    for (FragmentId n = node; n != fragment; n = parent[n]) {
+                        path.push_back(n);
+                    }
+                    path.push_back(fragment);
+                    std::reverse(path.begin(), path.end());
+                    throw CircularDependencyError(build_cycle_string(path));
+                }
+                if (parent[next] == SymbolTable::npos) {
+                    parent[next] = node;
+                    queue.push_back(next);
+                }
+            }
+        }
+    }
+
+    void check_for_cycles_through(const std::string& fragment_name) const {
+        FragmentId fragment = symbols_.find(fragment_name);
+        if (fragment != SymbolTable::npos) check_for_cycles_through(fragment);
+    }
+
+    // Fragments that directly depend on a fragment
+    const std::vector<FragmentId>& dependents_of(FragmentId fragment) const {
+        static const std::vector<FragmentId> none;
+        return fragment < dependents_.size() ? dependents_[fragment] : none;
+    }
+
+    // A fragment followed by every fragment that depends on it, directly or
+    // transitively, found by walking the reverse edges
+    std::vector<FragmentId> transitive_dependents(FragmentId fragment) const {
+        std::vector<FragmentId> found{fragment};
+        if (fragment >= dependents_.size()) return found;
+
+        std::vector<bool> seen(dependents_.size(), false);
+        seen[fragment] = true;
+        for (size_t head = 0; head < found.size(); ++head) {
+            for (FragmentId dependent : dependents_[found[head]]) {
+                if (!seen[dependent]) {
+                    seen[dependent] = true;
+                    found.push_back(dependent);
+                }
+            }
+        }
+        return found;
+    }
+
+    // Direct dependencies of a fragment
+    const std::vector<FragmentId>& dependencies_of(FragmentId fragment) const {
+        static const std::vector<FragmentId> none;
+        return fragment < edges_.size() ? edges_[fragment] : none;
+    }
+
+    // Access the dependency map (for debugging/testing)
+    std::map<std::string, std::set<std::string>> get_dependencies() const {
+        std::map<std::string, std::set<std::string>> dependencies;
+        for (FragmentId from = 0; from < edges_.size(); ++from) {
+            if (edges_[from].empty()) continue;
+            auto& targets = dependencies[symbols_.name(from)];
+            for (FragmentId to : edges_[from]) {
+                targets.insert(symbols_.name(to));
             }
-            return true;
         }
+        return dependencies;
+    }
 
-        if (visited.find(start) != visited.end()) {
-            return false;
+private:
+    // Grow the per-fragment tables to cover an ID
+    void reserve(FragmentId fragment) {
+        if (fragment >= edges_.size()) {
+            edges_.resize(fragment + 1);
+            dependents_.resize(fragment + 1);
+            on_evaluation_stack_.resize(fragment + 1, false);
         }
+    }
+
+    static uint64_t edge_key(FragmentId from, FragmentId to) {
+        return (static_cast<uint64_t>(from) << 32) | to;
+    }
 
-        visited.insert(start);
-        path.push_back(start);
+    // Returns the fragments of one cycle in dependency order, or nothing if
+    // the graph is acyclic. Iterative, so deep chains cannot overflow the stack.
+    std::vector<FragmentId> find_cycle() const {
+        const size_t count = edges_.size();
+        std::vector<size_t> index(count, npos);
+        std::vector<size_t> lowlink(count, 0);
+        std::vector<bool> on_stack(count, false);
+        std::vector<FragmentId> component_stack;
+        size_t next_index = 0;
 
-        auto deps_it = dependencies_.find(start);
-        if (deps_it != dependencies_.end()) {
-            for (const auto& dep : deps_it->second) {
-                if (has_cycle_from(dep, visited, path)) {
-                    return true;
+        struct Frame {
+            FragmentId node;
+            size_t next_edge;
+        };
+        std::vector<Frame> call_stack;
+
+        auto visit = [&](FragmentId node) {
+            index[node] = lowlink[node] = next_index++;
+            component_stack.push_back(node);
+            on_stack[node] = true;
+            call_stack.push_back({node, 0});
+        };
+
+        for (FragmentId root = 0; root < count; ++root) {
+            if (index[root] != npos) continue;
+            visit(root);
+
+            while (!call_stack.empty()) {
+                FragmentId node = call_stack.back().node;
+                size_t edge = call_stack.back().next_edge;
+
+                if (edge < edges_[node].size()) {
+                    ++call_stack.back().next_edge;
+                    FragmentId next = edges_[node][edge];
+                    if (index[next] == npos) {
+                        visit(next);
+                    } else if (on_stack[next]) {
+                        lowlink[node] = std::min(lowlink[node], index[next]);
+                    }
+                    continue;
+                }
+
+                call_stack.pop_back();
+                if (!call_stack.empty()) {
+                    FragmentId parent = call_stack.back().node;
+                    lowlink[parent] = std::min(lowlink[parent], lowlink[node]);
+                }
+
+                if (lowlink[node] != index[node]) continue;
+
+                // The component is the top of the stack down to node
+                auto first = std::find(component_stack.rbegin(), component_stack.rend(), node).base() - 1;
+                bool self_loop = std::find(edges_[node].begin(), edges_[node].end(), node)
+                                 != edges_[node].end();
+                if (component_stack.end() - first > 1 || self_loop) {
+                    std::vector<bool> in_component(count, false);
+                    for (auto it = first; it != component_stack.end(); ++it) in_component[*it] = true;
+                    return cycle_within(node, in_component);
                 }
+
+                for (auto it = first; it != component_stack.end(); ++it) on_stack[*it] = false;
+                component_stack.erase(first, component_stack.end());
             }
         }
+        return {};
+    }
+
+    // Finds the shortest cycle through start that stays inside one component
+    std::vector<FragmentId> cycle_within(FragmentId start, const std::vector<bool>& in_component) const {
+        std::vector<FragmentId> parent(edges_.size(), SymbolTable::npos);
+        std::vector<FragmentId> queue{start};
+        parent[start] = start;
 
-        path.pop_back();
-        return false;
+        for (size_t head = 0; head < queue.size(); ++head) {
+            FragmentId node = queue[head];
+            for (FragmentId next : edges_[node]) {
+                if (next == start) {
+                    std::vector<FragmentId> path;
+                    for (FragmentId n = node; n != start; n = parent[n]) {
+                        path.push_back(n);
+                    }
+                    path.push_back(start);
+                    std::reverse(path.begin(), path.end());
+                    return path;
+                }
+                if (in_component[next] && parent[next] == SymbolTable::npos) {
+                    parent[next] = node;
+                    queue.push_back(next);
+                }
+            }
+        }
+        return {start};
     }
 
     // Build a string representation of a cycle path
-    static std::string build_cycle_string(const std::vector<std::string>& path) {
+    std::string build_cycle_string(const std::vector<FragmentId>& path) const {
         std::string cycle;
         for (size_t i = 0; i < path.size(); ++i) {
             if (i > 0) cycle += " -> ";
-            cycle += path[i];
+            cycle += symbols_.name(path[i]);
         }
         if (!path.empty()) {
-            cycle += " -> " + path.front();
+            cycle += " -> " + symbols_.name(path.front());
         }
         return cycle;
     }
 };
 
-} // namespace json_fragments
\ No newline at end of file
+} // namespace json_fragments
@@ -34,4 +34,33 @@ public:
             "Fragment used as key must resolve to a string: " + key) {}
 };
 
+// Thrown when a fragment source cannot be read or is not valid JSON
+class FragmentSourceError : public JsonFragmentsError {
+public:
+    explicit FragmentSourceError(const std::string& message)
+        : JsonFragmentsError("Fragment source error: " + message) {}
+};
+
+// Thrown when a JSON pointer does not lead to a value in the resolved document
+class PointerNotFoundError : public JsonFragmentsError {
+public:
+    explicit PointerNotFoundError(const std::string& pointer)
+        : JsonFragmentsError("No value at JSON pointer: " + pointer) {}
+};
+
+// Thrown when a saved compiled plan is truncated, corrupt, or was written
+// by an incompatible version or configuration
+class PlanFormatError : public JsonFragmentsError {
+public:
+    explicit PlanFormatError(const std::string& message)
+        : JsonFragmentsError("Invalid compiled plan: " + message) {}
+};
+
+// Thrown when a resolve reaches one of the limits in its configuration
+class ResourceLimitError : public JsonFragmentsError {
+public:
+    explicit ResourceLimitError(const std::string& limit)
+        : JsonFragmentsError("Resource limit exceeded: " + limit) {}
+};
+
 } // namespace json_fragments
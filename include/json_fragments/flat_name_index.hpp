@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+namespace json_fragments {
+
+// Open-addressing hash index from names to dense positions, for containers
+// that store the names themselves. Each slot holds a position and the full
+// hash of its name in one flat array, so a probe walks adjacent memory and
+// only compares strings when the hashes match. Collisions are resolved by
+// linear probing, and the table is kept at most half full.
+class FlatNameIndex {
+public:
+    static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+    static size_t hash(std::string_view name) { return std::hash<std::string_view>{}(name); }
+
+    // The position stored for a name, or npos. name_at(position) must
+    // return the name stored at a position.
+    template <typename NameAt>
+    uint32_t find(std::string_view name, NameAt&& name_at) const {
+        if (slots_.empty()) return npos;
+        const size_t name_hash = hash(name);
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = name_hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots_[i];
+            if (slot.position == npos) return npos;
+            if (slot.hash == name_hash && name_at(slot.position) == name) return slot.position;
+        }
+    }
+
+    // Records the position of a name that is not in the index yet
+    void insert(std::string_view name, uint32_t position) {
+        if ((size_ + 1) * 2 > slots_.size()) {
+            rehash(slots_.empty() ? 16 : slots_.size() * 2);
+        }
+        place({hash(name), position});
+        ++size_;
+    }
+
+    // Makes room for count names without rehashing
+    void reserve(size_t count) {
+        size_t capacity = slots_.empty() ? 16 : slots_.size();
+        while (count * 2 > capacity) capacity *= 2;
+        if (capacity != slots_.size()) rehash(capacity);
+    }
+
+    size_t size() const { return size_; }
+
+private:
+    struct Slot {
+        size_t hash = 0;
+        uint32_t position = npos;
+    };
+
+    std::vector<Slot> slots_;
+    size_t size_ = 0;
+
+    void place(Slot slot) {
+        const size_t mask = slots_.size() - 1;
+        size_t i = slot.hash & mask;
+        while (slots_[i].position != npos) i = (i + 1) & mask;
+        slots_[i] = slot;
+    }
+
+    // Stored hashes let the slots move without looking at the names
+    void rehash(size_t capacity) {
+        std::vector<Slot> old(capacity);
+        old.swap(slots_);
+        for (const Slot& slot : old) {
+            if (slot.position != npos) place(slot);
+        }
+    }
+};
+
+} // namespace json_fragments
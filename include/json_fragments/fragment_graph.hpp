@@ -0,0 +1,62 @@
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "fragment_nodes.hpp"
+#include "resolve_stats.hpp"
+
+namespace json_fragments {
+
+// The fragments of a compiled set and the references between them, for
+// inspecting where resolve time goes or drawing the set with Graphviz.
+// References a nested template only discovers while expanding are not
+// part of the graph.
+class FragmentGraph {
+public:
+    // Collects the references in every compiled tree
+    explicit FragmentGraph(const CompiledFragments& compiled);
+
+    // Number of fragments, including referenced ones that do not exist
+    size_t size() const { return names_.size(); }
+
+    const std::string& name(FragmentId fragment) const { return names_[fragment]; }
+
+    // Whether a fragment has a compiled tree; false for missing fragments
+    bool exists(FragmentId fragment) const { return exists_[fragment]; }
+
+    // Fragments a fragment refers to directly, each listed once
+    const std::vector<FragmentId>& dependencies_of(FragmentId fragment) const {
+        return edges_[fragment];
+    }
+
+    // Dependencies by name, in the form DependencyTracker::get_dependencies()
+    // returns them
+    std::map<std::string, std::set<std::string>> dependencies() const;
+
+    // Up to count of the longest chains of references, longest first. Each
+    // chain starts at a different fragment that nothing refers to and names
+    // every fragment on the way, so its length is how deep a resolve of
+    // that fragment nests.
+    std::vector<std::vector<std::string>> longest_chains(size_t count) const;
+
+    // Writes the graph in Graphviz DOT form. With a profile, fragments are
+    // labelled with its evaluations, time and output size, and the hottest
+    // are filled in.
+    void write_dot(std::ostream& out, const ResolveStats* profile = nullptr) const;
+
+    // The graph as JSON: every fragment with its dependencies, and the
+    // longest chains. With a profile, fragments carry its figures and the
+    // hottest are listed, both up to report_count.
+    nlohmann::json to_json(const ResolveStats* profile = nullptr, size_t report_count = 10) const;
+
+private:
+    std::vector<std::string> names_;
+    std::vector<bool> exists_;
+    std::vector<std::vector<FragmentId>> edges_;
+};
+
+} // namespace json_fragments
@@ -1,89 +1,348 @@
 #pragma once
 
+#include <algorithm>
 #include "fragment_nodes.hpp"
 #include "exceptions.hpp"
 
 namespace json_fragments {
 
-// Represents a literal JSON value (number, boolean, null, or simple string)
+// Whether a container with this many children should be split across the
+// configured thread pool
+inline bool should_evaluate_in_parallel(size_t children, const JsonResolverConfig& config) {
+    return config.parallel.pool && config.parallel.pool->size() > 0 &&
+           children >= std::max<size_t>(config.parallel.min_children, 2);
+}
+
+// Evaluates children [0, count) in contiguous chunks on the configured pool.
+// Each chunk gets a context forked from the caller's, so chunks never share
+// mutable state; body(i, chunk_context) must only write to slot i.
+template <typename Body>
+void evaluate_in_parallel(
+    size_t count,
+    const JsonResolverConfig& config,
+    const EvaluationContext& context,
+    Body&& body
+) {
+    ThreadPool& pool = *config.parallel.pool;
+    size_t chunks = std::min(count, (pool.size() + 1) * 4);
+    pool.parallel_for(chunks, [&](size_t chunk) {
+        EvaluationContext chunk_context = context.fork();
+        size_t end = (chunk + 1) * count / chunks;
+        for (size_t i = chunk * count / chunks; i < end; ++i) {
+            body(i, chunk_context);
+        }
+    });
+}
+
+// Represents a JSON value without references: a scalar, a simple string,
+// or a whole object or array with no references anywhere inside. The value
+// is not copied; the node points at the fragment it was parsed from, and a
+// consuming resolve moves it out.
 class LiteralNode : public FragmentNode {
-    nlohmann::json value_;
+    const nlohmann::json* value_;
+    std::string_view serialized_;
     
 public:
-    explicit LiteralNode(nlohmann::json value) : value_(std::move(value)) {}
+    // The value, and its serialized text if given, must outlive the node
+    explicit LiteralNode(const nlohmann::json& value, std::string_view serialized = {})
+        : value_(&value)
+        , serialized_(serialized) {}
     
     nlohmann::json evaluate(
         const std::map<std::string, nlohmann::json>&,
-        const JsonResolverConfig&
+        const JsonResolverConfig&,
+        EvaluationContext& context
+    ) const override {
+        // Moved or copied, the value ends up in the output
+        if (ResolveBudget* budget = context.budget()) budget->add_copy(*value_);
+        if (context.consumes_literals()) {
+            // The resolve owns the value, which is not const storage
+            return std::move(*const_cast<nlohmann::json*>(value_));
+        }
+        return *value_;
+    }
+    
+    nlohmann::json evaluate_at(
+        const PointerPath& path,
+        size_t depth,
+        const std::map<std::string, nlohmann::json>&,
+        const JsonResolverConfig&,
+        EvaluationContext& context
+    ) const override {
+        const nlohmann::json* found = path.find(*value_, depth);
+        if (!found) path.not_found();
+        if (ResolveBudget* budget = context.budget()) budget->add_copy(*found);
+        return *found;
+    }
+    
+    void write(
+        const std::map<std::string, nlohmann::json>&,
+        const JsonResolverConfig&,
+        EvaluationContext& context,
+        JsonWriter& writer
     ) const override {
-        return value_;
+        if (ResolveBudget* budget = context.budget()) budget->add_copy(*value_);
+        if (serialized_.empty()) {
+            writer.value(*value_);
+        } else {
+            writer.raw(serialized_);
+        }
     }
     
     void accept(FragmentVisitor& visitor) override {
         visitor.visit(*this);
     }
     
-    const nlohmann::json& value() const { return value_; }
+    const nlohmann::json* constant_value() const override { return value_; }
+    
+    const nlohmann::json& value() const { return *value_; }
+    std::string_view serialized() const { return serialized_; }
 };
 
 // Represents a reference to another fragment
 class ReferenceNode : public FragmentNode {
-    std::string fragment_name_;
-    EvaluationContext& context_;
+    FragmentId fragment_id_;
+    const std::string& fragment_name_;
     
 public:
-    ReferenceNode(std::string name, EvaluationContext& context) 
-        : fragment_name_(std::move(name))
-        , context_(context) {}
+    // The name must outlive the node; the parser passes the interned name
+    ReferenceNode(FragmentId id, const std::string& name) 
+        : fragment_id_(id)
+        , fragment_name_(name) {}
     
     nlohmann::json evaluate(
         const std::map<std::string, nlohmann::json>& fragments,
-        const JsonResolverConfig& config
+        const JsonResolverConfig& config,
+        EvaluationContext& context
     ) const override {
-        auto it = fragments.find(fragment_name_);
-        if (it == fragments.end()) {
-            switch (config.missing_fragment_behavior) {
-                case JsonResolverConfig::MissingFragmentBehavior::Throw:
-                    throw FragmentNotFoundError(fragment_name_);
-                case JsonResolverConfig::MissingFragmentBehavior::LeaveUnresolved:
-                    return config.delimiters.start + fragment_name_ + config.delimiters.end;
-                case JsonResolverConfig::MissingFragmentBehavior::UseDefault:
-                    return config.default_value;
-                case JsonResolverConfig::MissingFragmentBehavior::Remove:
-                    return "";
-            }
+        // Add fragment to evaluation path for better error messages
+        EvaluationContext::ScopedComponent path_component(context, fragment_name_);
+        if (const FragmentNode* node = context.single_use_node(fragment_id_)) {
+            return context.evaluate_single_use(fragment_id_, *node, fragments, config);
+        }
+        const nlohmann::json* value = context.resolve_fragment(fragment_id_, fragments, config);
+        if (!value) {
+            return missing_value(fragment_name_, config);
         }
         
-        // Add fragment to evaluation path for better error messages
-        EvaluationContext::ScopedComponent path_component(context_, fragment_name_);
-        return it->second;
+        if (ResolveStats* stats = context.stats()) ++stats->value_copies;
+        if (ResolveBudget* budget = context.budget()) budget->add_copy(*value);
+        return *value;
+    }
+    
+    // Descends into the referenced fragment's tree instead of evaluating
+    // all of it, unless this resolve already has its value
+    nlohmann::json evaluate_at(
+        const PointerPath& path,
+        size_t depth,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context
+    ) const override {
+        if (depth == path.size()) {
+            return evaluate(fragments, config, context);
+        }
+        EvaluationContext::ScopedComponent path_component(context, fragment_name_);
+        const FragmentNode* node = context.node(fragment_id_);
+        if (node && !context.memoized(fragment_id_)) {
+            if (ResolveStats* stats = context.stats()) ++stats->reference_lookups;
+            return context.evaluate_fragment_at(*node, path, depth, fragments, config);
+        }
+        const nlohmann::json* value = context.resolve_fragment(fragment_id_, fragments, config);
+        nlohmann::json missing;
+        if (!value) {
+            missing = missing_value(fragment_name_, config);
+            value = &missing;
+        }
+        const nlohmann::json* found = path.find(*value, depth);
+        if (!found) path.not_found();
+        if (ResolveBudget* budget = context.budget()) budget->add_copy(*found);
+        return *found;
+    }
+    
+    void write(
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context,
+        JsonWriter& writer
+    ) const override {
+        EvaluationContext::ScopedComponent path_component(context, fragment_name_);
+        // Stream the fragment itself unless other references may need its
+        // value again, in which case it is resolved and kept as usual
+        const FragmentNode* node = context.single_use_node(fragment_id_);
+        if (!node) {
+            node = context.node(fragment_id_);
+            if (node && !node->constant_value()) node = nullptr;
+        }
+        if (node) {
+            if (ResolveStats* stats = context.stats()) ++stats->reference_lookups;
+            node->write(fragments, config, context, writer);
+            return;
+        }
+        
+        const nlohmann::json* value = context.resolve_fragment(fragment_id_, fragments, config);
+        if (!value) {
+            writer.value(missing_value(fragment_name_, config));
+            return;
+        }
+        if (ResolveBudget* budget = context.budget()) budget->add_copy(*value);
+        writer.value(*value);
+    }
+    
+    // What a reference to a missing fragment evaluates to, if anything
+    static nlohmann::json missing_value(const std::string& fragment_name, const JsonResolverConfig& config) {
+        switch (config.missing_fragment_behavior) {
+            case JsonResolverConfig::MissingFragmentBehavior::Throw:
+                break;
+            case JsonResolverConfig::MissingFragmentBehavior::LeaveUnresolved:
+                return config.delimiters.start + fragment_name + config.delimiters.end;
+            case JsonResolverConfig::MissingFragmentBehavior::UseDefault:
+                return config.default_value;
+            case JsonResolverConfig::MissingFragmentBehavior::Remove:
+                return "";
+        }
+        throw FragmentNotFoundError(fragment_name);
     }
     
     void accept(FragmentVisitor& visitor) override {
         visitor.visit(*this);
     }
     
+    FragmentId fragment_id() const { return fragment_id_; }
     const std::string& fragment_name() const { return fragment_name_; }
 };
 
 // Represents a string that might contain fragment references
 class StringTemplateNode : public FragmentNode {
-    std::string template_text_;
-    EvaluationContext& context_;
+public:
+    // One piece of a pre-tokenized template: literal text followed by an
+    // optional reference. The trailing segment has no reference.
+    struct Segment {
+        std::string_view literal;
+        FragmentId fragment = SymbolTable::npos;
+        const std::string* fragment_name = nullptr;  // Interned name of fragment
+    };
+
+private:
+    std::string_view template_text_;
+    ArenaArray<Segment> segments_;
+    size_t literal_length_ = 0;
     
 public:
-    StringTemplateNode(std::string text, EvaluationContext& context)
-        : template_text_(std::move(text))
-        , context_(context) {}
+    // The text and segments must outlive the node; the parser stores them
+    // in the same arena as the node
+    StringTemplateNode(std::string_view text, ArenaArray<Segment> segments)
+        : template_text_(text)
+        , segments_(segments) {
+        for (const auto& segment : segments_) {
+            literal_length_ += segment.literal.length();
+        }
+    }
     
     nlohmann::json evaluate(
         const std::map<std::string, nlohmann::json>& fragments,
-        const JsonResolverConfig& config
+        const JsonResolverConfig& config,
+        EvaluationContext& context
     ) const override {
-        std::string result = template_text_;
+        if (config.template_expansion == JsonResolverConfig::TemplateExpansion::Nested) {
+            return evaluate_nested(fragments, config, context);
+        }
+
+        ResolveStats* stats = context.stats();
+        std::string result;
+        result.reserve(literal_length_);
+
+        for (const auto& segment : segments_) {
+            result += segment.literal;
+            if (segment.fragment == SymbolTable::npos) continue;
+
+            const std::string& fragment_name = *segment.fragment_name;
+            try {
+                EvaluationContext::ScopedComponent path_component(
+                    context,
+                    EvaluationContext::ScopedComponent::Template{fragment_name}
+                );
+
+                const nlohmann::json* value =
+                    context.resolve_fragment(segment.fragment, fragments, config);
+                if (!value) {
+                    switch (config.missing_fragment_behavior) {
+                        case JsonResolverConfig::MissingFragmentBehavior::Throw:
+                            throw FragmentNotFoundError(fragment_name);
+                        case JsonResolverConfig::MissingFragmentBehavior::LeaveUnresolved:
+                            result += config.delimiters.start;
+                            result += fragment_name;
+                            result += config.delimiters.end;
+                            break;
+                        case JsonResolverConfig::MissingFragmentBehavior::UseDefault:
+                            if (!config.default_value.is_string()) {
+                                throw InvalidKeyError(
+                                    "Default value for string template must be string"
+                                );
+                            }
+                            result += config.default_value.get_ref<const std::string&>();
+                            break;
+                        case JsonResolverConfig::MissingFragmentBehavior::Remove:
+                            break;
+                    }
+                    continue;
+                }
+
+                if (!value->is_string()) {
+                    throw InvalidKeyError(
+                        "Fragment in string template must resolve to string: " +
+                        fragment_name
+                    );
+                }
+                result += value->get_ref<const std::string&>();
+                if (stats) ++stats->template_substitutions;
+
+            } catch (const ResourceLimitError&) {
+                throw;
+            } catch (const JsonFragmentsError& e) {
+                throw JsonFragmentsError(
+                    std::string(e.what()) + " at " + context.path_string()
+                );
+            }
+        }
+
+        if (stats) {
+            ++stats->template_passes;
+            stats->bytes_copied += result.size();
+        }
+        if (ResolveBudget* budget = context.budget()) budget->add_output(result.size());
+        return result;
+    }
+    
+    void accept(FragmentVisitor& visitor) override {
+        visitor.visit(*this);
+    }
+    
+    std::string_view template_text() const { return template_text_; }
+    ArenaArray<const Segment> segments() const { return {segments_.begin(), segments_.size()}; }
+
+private:
+    // Expands innermost references and rescans the result until nothing
+    // changes, so substituted text and composed names are expanded too
+    nlohmann::json evaluate_nested(
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context
+    ) const {
+        ResolveStats* stats = context.stats();
+        ResolveBudget* budget = context.budget();
+        std::string result(template_text_);
         bool made_changes;
+        size_t passes = 0;
         
         do {
+            if (stats) ++stats->template_passes;
+            if (budget) {
+                // Each pass rescans and may grow the whole text
+                budget->check_passes(++passes);
+                budget->check_deadline();
+                if (passes > 1) budget->add_output(result.size());
+            }
             made_changes = false;
             size_t pos = 0;
             
@@ -106,12 +365,13 @@ public:
                 
                 try {
                     EvaluationContext::ScopedComponent path_component(
-                        context_, 
-                        "template:" + fragment_name
+                        context,
+                        EvaluationContext::ScopedComponent::Template{fragment_name}
                     );
                     
-                    auto it = fragments.find(fragment_name);
-                    if (it == fragments.end()) {
+                    const nlohmann::json* value =
+                        context.resolve_fragment(fragment_name, fragments, config);
+                    if (!value) {
                         switch (config.missing_fragment_behavior) {
                             case JsonResolverConfig::MissingFragmentBehavior::Throw:
                                 throw FragmentNotFoundError(fragment_name);
@@ -130,6 +390,7 @@ public:
                                     config.default_value.get<std::string>()
                                 );
                                 made_changes = true;
+                                if (stats) ++stats->template_substitutions;
                                 break;
                             case JsonResolverConfig::MissingFragmentBehavior::Remove:
                                 result.replace(
@@ -138,12 +399,13 @@ public:
                                     ""
                                 );
                                 made_changes = true;
+                                if (stats) ++stats->template_substitutions;
                                 break;
                         }
                         continue;
                     }
                     
-                    if (!it->second.is_string()) {
+                    if (!value->is_string()) {
                         throw InvalidKeyError(
                             "Fragment in string template must resolve to string: " + 
                             fragment_name
@@ -153,102 +415,313 @@ public:
                     result.replace(
                         start_pos,
                         end_pos + config.delimiters.end.length() - start_pos,
-                        it->second.get<std::string>()
+                        value->get<std::string>()
                     );
                     made_changes = true;
+                    if (stats) ++stats->template_substitutions;
                     
+                } catch (const ResourceLimitError&) {
+                    throw;
                 } catch (const JsonFragmentsError& e) {
                     throw JsonFragmentsError(
-                        std::string(e.what()) + " at " + context_.path_string()
+                        std::string(e.what()) + " at " + context.path_string()
                     );
                 }
             }
         } while (made_changes);
         
+        if (stats) stats->bytes_copied += result.size();
+        if (budget) budget->add_output(result.size());
         return result;
     }
-    
-    void accept(FragmentVisitor& visitor) override {
-        visitor.visit(*this);
-    }
-    
-    const std::string& template_text() const { return template_text_; }
 };
 
 // Represents a JSON object with possibly dynamic keys
 class ObjectNode : public FragmentNode {
-    std::vector<std::pair<FragmentNodePtr, FragmentNodePtr>> entries_;
-    EvaluationContext& context_;
-    
 public:
-    explicit ObjectNode(EvaluationContext& context) : context_(context) {}
+    // A key node and its value node
+    using Entry = std::pair<FragmentNodePtr, FragmentNodePtr>;
+
+private:
+    ArenaArray<Entry> entries_;
     
-    void add_entry(FragmentNodePtr key, FragmentNodePtr value) {
-        entries_.emplace_back(std::move(key), std::move(value));
-    }
+    // One per entry when every key is a literal string and the keys are
+    // strictly ascending, as they are when parsed from a JSON object, and
+    // empty otherwise. The result can then be built in order from these
+    // strings, with no key evaluated and no tree search.
+    ArenaArray<const std::string*> static_keys_;
+    
+public:
+    // The entries must be complete when the node is created; the static
+    // keys are stored in the same arena
+    ObjectNode(ArenaArray<Entry> entries, NodeArena& arena)
+        : entries_(entries)
+        , static_keys_(find_static_keys(entries, arena)) {}
     
     nlohmann::json evaluate(
         const std::map<std::string, nlohmann::json>& fragments,
-        const JsonResolverConfig& config
+        const JsonResolverConfig& config,
+        EvaluationContext& context
     ) const override {
+        if (!static_keys_.empty()) {
+            return evaluate_static(fragments, config, context);
+        }
+        
         nlohmann::json result;
         
-        for (const auto& [key_node, value_node] : entries_) {
-            auto key_result = key_node->evaluate(fragments, config);
-            if (!key_result.is_string()) {
-                throw InvalidKeyError("Object key must evaluate to string");
+        if (should_evaluate_in_parallel(entries_.size(), config)) {
+            std::vector<std::pair<std::string, nlohmann::json>> evaluated(entries_.size());
+            evaluate_in_parallel(entries_.size(), config, context,
+                [&](size_t i, EvaluationContext& chunk_context) {
+                    evaluated[i] = evaluate_entry(i, fragments, config, chunk_context);
+                });
+            // Insert in source order so later duplicate keys still win
+            for (auto& [key, value] : evaluated) {
+                result[key] = std::move(value);
             }
-            
-            std::string key = key_result.get<std::string>();
-            EvaluationContext::ScopedComponent path_component(context_, key);
-            
-            result[key] = value_node->evaluate(fragments, config);
+            return result;
+        }
+        
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            auto [key, value] = evaluate_entry(i, fragments, config, context);
+            result[key] = std::move(value);
         }
         
         return result;
     }
     
+    // Evaluates keys until the last entry with the path's key is found,
+    // and only that entry's value
+    nlohmann::json evaluate_at(
+        const PointerPath& path,
+        size_t depth,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context
+    ) const override {
+        if (depth == path.size()) {
+            return evaluate(fragments, config, context);
+        }
+        if (!static_keys_.empty()) {
+            const std::string& token = path.token(depth);
+            const std::string* const* key = std::lower_bound(static_keys_.begin(), static_keys_.end(), token,
+                [](const std::string* k, const std::string& wanted) { return *k < wanted; });
+            if (key == static_keys_.end() || **key != token) {
+                path.not_found();
+            }
+            EvaluationContext::ScopedComponent path_component(context, token);
+            return entries_[key - static_keys_.begin()].second->evaluate_at(
+                path, depth + 1, fragments, config, context);
+        }
+        for (size_t i = entries_.size(); i-- > 0;) {
+            std::string key = evaluate_key(i, fragments, config, context);
+            if (key == path.token(depth)) {
+                EvaluationContext::ScopedComponent path_component(context, key);
+                return entries_[i].second->evaluate_at(path, depth + 1, fragments, config, context);
+            }
+        }
+        path.not_found();
+    }
+    
+    // Evaluates every key first so that entries can be written in the
+    // sorted order a built object would have; of duplicate keys, only the
+    // last is written
+    void write(
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context,
+        JsonWriter& writer
+    ) const override {
+        if (entries_.empty()) {
+            FragmentNode::write(fragments, config, context, writer);
+            return;
+        }
+        if (!static_keys_.empty()) {
+            writer.begin_object();
+            for (size_t i = 0; i < entries_.size(); ++i) {
+                const std::string& key = static_key(i);
+                EvaluationContext::ScopedComponent path_component(context, key);
+                writer.key(key);
+                entries_[i].second->write(fragments, config, context, writer);
+            }
+            writer.end_object();
+            return;
+        }
+        
+        std::vector<std::string> keys;
+        keys.reserve(entries_.size());
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            keys.push_back(evaluate_key(i, fragments, config, context));
+        }
+        std::vector<size_t> order(entries_.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+        
+        writer.begin_object();
+        for (size_t k = 0; k < order.size(); ++k) {
+            size_t i = order[k];
+            if (k + 1 < order.size() && keys[order[k + 1]] == keys[i]) continue;
+            
+            EvaluationContext::ScopedComponent path_component(context, keys[i]);
+            writer.key(keys[i]);
+            entries_[i].second->write(fragments, config, context, writer);
+        }
+        writer.end_object();
+    }
+    
     void accept(FragmentVisitor& visitor) override {
         visitor.visit(*this);
     }
     
-    const auto& entries() const { return entries_; }
+    ArenaArray<const Entry> entries() const { return {entries_.begin(), entries_.size()}; }
+
+private:
+    static ArenaArray<const std::string*> find_static_keys(ArenaArray<Entry> entries, NodeArena& arena) {
+        const std::string* previous = nullptr;
+        for (const auto& [key, value] : entries) {
+            const nlohmann::json* constant = key->constant_value();
+            if (!constant || !constant->is_string()) return {};
+            const std::string& name = constant->get_ref<const std::string&>();
+            if (previous && !(*previous < name)) return {};
+            previous = &name;
+        }
+        
+        auto keys = arena.make_array<const std::string*>(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            keys[i] = &entries[i].first->constant_value()->get_ref<const std::string&>();
+        }
+        return keys;
+    }
+    
+    const std::string& static_key(size_t i) const { return *static_keys_[i]; }
+    
+    // Builds the result in key order, so every insertion lands at the end
+    // of the object's map and costs amortized constant time
+    nlohmann::json evaluate_static(
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context
+    ) const {
+        nlohmann::json result(nlohmann::json::value_t::object);
+        auto& object = result.get_ref<nlohmann::json::object_t&>();
+        
+        if (should_evaluate_in_parallel(entries_.size(), config)) {
+            std::vector<nlohmann::json> values(entries_.size());
+            evaluate_in_parallel(entries_.size(), config, context,
+                [&](size_t i, EvaluationContext& chunk_context) {
+                    EvaluationContext::ScopedComponent path_component(chunk_context, static_key(i));
+                    values[i] = entries_[i].second->evaluate(fragments, config, chunk_context);
+                });
+            for (size_t i = 0; i < entries_.size(); ++i) {
+                object.emplace_hint(object.end(), static_key(i), std::move(values[i]));
+            }
+            return result;
+        }
+        
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            const std::string& key = static_key(i);
+            EvaluationContext::ScopedComponent path_component(context, key);
+            object.emplace_hint(object.end(), key, entries_[i].second->evaluate(fragments, config, context));
+        }
+        return result;
+    }
+    
+    std::string evaluate_key(
+        size_t i,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context
+    ) const {
+        auto key_result = entries_[i].first->evaluate(fragments, config, context);
+        if (!key_result.is_string()) {
+            throw InvalidKeyError("Object key must evaluate to string");
+        }
+        return std::move(key_result.get_ref<std::string&>());
+    }
+    
+    std::pair<std::string, nlohmann::json> evaluate_entry(
+        size_t i,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context
+    ) const {
+        std::string key = evaluate_key(i, fragments, config, context);
+        EvaluationContext::ScopedComponent path_component(context, key);
+        
+        auto value = entries_[i].second->evaluate(fragments, config, context);
+        return {std::move(key), std::move(value)};
+    }
 };
 
 // Represents a JSON array
 class ArrayNode : public FragmentNode {
-    std::vector<FragmentNodePtr> elements_;
-    EvaluationContext& context_;
+    ArenaArray<FragmentNodePtr> elements_;
     
 public:
-    explicit ArrayNode(EvaluationContext& context) : context_(context) {}
-    
-    void add_element(FragmentNodePtr element) {
-        elements_.push_back(std::move(element));
-    }
+    explicit ArrayNode(ArenaArray<FragmentNodePtr> elements) : elements_(elements) {}
     
     nlohmann::json evaluate(
         const std::map<std::string, nlohmann::json>& fragments,
-        const JsonResolverConfig& config
+        const JsonResolverConfig& config,
+        EvaluationContext& context
     ) const override {
         nlohmann::json result = nlohmann::json::array();
         
+        if (should_evaluate_in_parallel(elements_.size(), config)) {
+            auto& values = result.get_ref<nlohmann::json::array_t&>();
+            values.resize(elements_.size());
+            evaluate_in_parallel(elements_.size(), config, context,
+                [&](size_t i, EvaluationContext& chunk_context) {
+                    EvaluationContext::ScopedComponent path_component(chunk_context, i);
+                    values[i] = elements_[i]->evaluate(fragments, config, chunk_context);
+                });
+            return result;
+        }
+        
         for (size_t i = 0; i < elements_.size(); ++i) {
-            EvaluationContext::ScopedComponent path_component(
-                context_, 
-                std::to_string(i)
-            );
-            result.push_back(elements_[i]->evaluate(fragments, config));
+            EvaluationContext::ScopedComponent path_component(context, i);
+            result.push_back(elements_[i]->evaluate(fragments, config, context));
         }
         
         return result;
     }
     
+    nlohmann::json evaluate_at(
+        const PointerPath& path,
+        size_t depth,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context
+    ) const override {
+        if (depth == path.size()) {
+            return evaluate(fragments, config, context);
+        }
+        size_t i = PointerPath::index(path.token(depth));
+        if (i >= elements_.size()) path.not_found();
+        EvaluationContext::ScopedComponent path_component(context, i);
+        return elements_[i]->evaluate_at(path, depth + 1, fragments, config, context);
+    }
+    
+    void write(
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context,
+        JsonWriter& writer
+    ) const override {
+        writer.begin_array();
+        for (size_t i = 0; i < elements_.size(); ++i) {
+            EvaluationContext::ScopedComponent path_component(context, i);
+            elements_[i]->write(fragments, config, context, writer);
+        }
+        writer.end_array();
+    }
+    
     void accept(FragmentVisitor& visitor) override {
         visitor.visit(*this);
     }
     
-    const auto& elements() const { return elements_; }
+    ArenaArray<const FragmentNodePtr> elements() const { return {elements_.begin(), elements_.size()}; }
 };
 
 } // namespace json_fragments
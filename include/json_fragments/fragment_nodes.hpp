@@ -1,35 +1,177 @@
 #pragma once
 
+#include <chrono>
+#include <deque>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <nlohmann/json.hpp>
+#include "exceptions.hpp"
+#include "fragment_source.hpp"
+#include "json_writer.hpp"
+#include "node_arena.hpp"
+#include "resolve_limits.hpp"
+#include "resolve_stats.hpp"
+#include "symbol_table.hpp"
+#include "thread_pool.hpp"
 
 namespace json_fragments {
 
 // Forward declarations
 class FragmentVisitor;
 class FragmentNode;
+class EvaluationContext;
 struct JsonResolverConfig;
 
-// Smart pointer alias for clarity
-using FragmentNodePtr = std::unique_ptr<FragmentNode>;
+// Nodes are owned by the NodeArena they were created in, never by pointers
+using FragmentNodePtr = FragmentNode*;
 
-// Base class for all nodes in our fragment tree
+// A JSON pointer split into its unescaped reference tokens, which
+// FragmentNode::evaluate_at() follows one container level at a time
+class PointerPath {
+    std::vector<std::string> tokens_;
+    std::string text_;
+
+public:
+    explicit PointerPath(const nlohmann::json::json_pointer& pointer)
+        : text_(pointer.to_string()) {
+        for (size_t pos = 0; pos < text_.size();) {
+            size_t end = text_.find('/', pos + 1);
+            if (end == std::string::npos) end = text_.size();
+            std::string token = text_.substr(pos + 1, end - pos - 1);
+            for (size_t i = 0; (i = token.find('~', i)) != std::string::npos; ++i) {
+                token.replace(i, 2, token[i + 1] == '1' ? "/" : "~");
+            }
+            tokens_.push_back(std::move(token));
+            pos = end;
+        }
+    }
+
+    size_t size() const { return tokens_.size(); }
+    const std::string& token(size_t depth) const { return tokens_[depth]; }
+
+    // The array index a token names, or npos if it is not a valid index
+    static size_t index(const std::string& token) {
+        if (token.empty() || (token.size() > 1 && token[0] == '0') ||
+            token.find_first_not_of("0123456789") != std::string::npos ||
+            token.size() > 18) {
+            return std::string::npos;
+        }
+        return std::stoull(token);
+    }
+
+    // Follows the tokens from depth on through an evaluated value, or
+    // returns nullptr if they lead nowhere
+    nlohmann::json* find(nlohmann::json& value, size_t depth) const {
+        return const_cast<nlohmann::json*>(find(static_cast<const nlohmann::json&>(value), depth));
+    }
+    const nlohmann::json* find(const nlohmann::json& value, size_t depth) const {
+        const nlohmann::json* current = &value;
+        for (; depth < tokens_.size(); ++depth) {
+            if (current->is_object()) {
+                auto it = current->find(tokens_[depth]);
+                if (it == current->end()) return nullptr;
+                current = &*it;
+            } else if (current->is_array()) {
+                size_t i = index(tokens_[depth]);
+                if (i >= current->size()) return nullptr;
+                current = &(*current)[i];
+            } else {
+                return nullptr;
+            }
+        }
+        return current;
+    }
+
+    [[noreturn]] void not_found() const { throw PointerNotFoundError(text_); }
+};
+
+// Base class for all nodes in our fragment tree. Nodes are only ever
+// destroyed by their arena, which knows their concrete type, so the
+// destructor is not virtual and simple nodes stay trivially destructible.
 class FragmentNode {
+protected:
+    ~FragmentNode() = default;
+
 public:
-    virtual ~FragmentNode() = default;
-    
-    // Core evaluation method - converts node to final JSON value
+    // Core evaluation method - converts node to final JSON value. The
+    // context holds all per-call state, so a tree can be evaluated from
+    // several threads at once as long as each uses its own context.
     virtual nlohmann::json evaluate(
         const std::map<std::string, nlohmann::json>& fragments,
-        const JsonResolverConfig& config
+        const JsonResolverConfig& config,
+        EvaluationContext& context
     ) const = 0;
     
+    // Writes the node's value as it is evaluated, without building it first.
+    // Nodes that cannot stream their parts evaluate and write the whole value.
+    virtual void write(
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context,
+        JsonWriter& writer
+    ) const {
+        writer.value(evaluate(fragments, config, context));
+    }
+    
+    // Evaluates only the part of the node's value that path leads to from
+    // token depth on. Objects and arrays evaluate just the child on the
+    // path, and references descend into the tree they refer to; other nodes
+    // evaluate their whole value and take the rest of the path from it.
+    // Throws PointerNotFoundError if the path leads nowhere.
+    virtual nlohmann::json evaluate_at(
+        const PointerPath& path,
+        size_t depth,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config,
+        EvaluationContext& context
+    ) const {
+        nlohmann::json value = evaluate(fragments, config, context);
+        nlohmann::json* found = path.find(value, depth);
+        if (!found) path.not_found();
+        return std::move(*found);
+    }
+    
     // Visitor pattern support
     virtual void accept(FragmentVisitor& visitor) = 0;
+    
+    // The value of a node that contains no references and so always
+    // evaluates to the same JSON, or nullptr
+    virtual const nlohmann::json* constant_value() const { return nullptr; }
 };
 
+// Parsed fragments, indexed by interned fragment ID
+struct CompiledFragments {
+    SymbolTable symbols;
+    std::vector<const nlohmann::json*> sources;  // Raw fragment values, nullptr if missing
+    std::vector<FragmentNodePtr> nodes;          // Parsed trees, nullptr if not parsed
+    std::vector<uint32_t> reference_counts;      // Places that refer to each fragment
+    NodeArena arena;                             // Owns every node of the trees
+
+    // Interns a fragment name, recording where its raw value lives the
+    // first time the name is seen
+    FragmentId add(std::string_view name, const nlohmann::json* source) {
+        FragmentId id = symbols.intern(name);
+        if (id == sources.size()) {
+            sources.push_back(source);
+            nodes.emplace_back();
+            reference_counts.push_back(0);
+        }
+        return id;
+    }
+
+    // The parsed tree of a fragment, or nullptr if it has none
+    const FragmentNode* node(FragmentId id) const {
+        return id < nodes.size() ? nodes[id] : nullptr;
+    }
+};
+
+class ResolveResultCache;
+
 // Configuration for the resolver's behavior
 struct JsonResolverConfig {
     // How to handle missing fragment references
@@ -45,9 +187,35 @@ struct JsonResolverConfig {
         std::string end = "]";
     };
     
+    // How string templates substitute their references
+    enum class TemplateExpansion {
+        SinglePass,         // Substitute each reference once, left to right (default)
+        Nested              // Rescan substituted text until nothing changes
+    };
+    
+    // How compiled fragments are evaluated
+    enum class EvaluationEngine {
+        Tree,               // Walk the node tree (default)
+        Bytecode            // Run each fragment as a flat instruction program
+    };
+    
     MissingFragmentBehavior missing_fragment_behavior = MissingFragmentBehavior::Throw;
     nlohmann::json default_value = nullptr;  // Used when behavior is UseDefault
+    // Opt-in parallel evaluation of wide objects and arrays
+    struct ParallelEvaluation {
+        std::shared_ptr<ThreadPool> pool;   // No pool disables parallel evaluation
+        size_t min_children = 1024;         // Only split containers at least this wide
+    };
+    
     Delimiters delimiters;
+    TemplateExpansion template_expansion = TemplateExpansion::SinglePass;
+    ParallelEvaluation parallel;            // Ignored by the bytecode engine
+    EvaluationEngine engine = EvaluationEngine::Tree;
+    // Opt-in cache of whole results, consulted by CompiledFragmentSet and
+    // IncrementalResolver; JsonResolver, whose fragments may change between
+    // calls, does not use it
+    std::shared_ptr<ResolveResultCache> result_cache;
+    ResolveLimits limits;                   // Unlimited by default
 };
 
 // Visitor interface for fragment nodes
@@ -62,43 +230,340 @@ public:
     virtual void visit(class ArrayNode& node) = 0;
 };
 
-// Class for tracking evaluation context and building error paths
+// Shared, immutable result of evaluating a fragment
+using ResolvedFragmentPtr = std::shared_ptr<const nlohmann::json>;
+
+// Store of evaluated fragments that outlives a single resolve. Contexts
+// consult it before evaluating a fragment and record new results in it.
+// Implementations must be safe to call from several threads at once.
+class FragmentResultCache {
+public:
+    virtual ~FragmentResultCache() = default;
+    
+    virtual ResolvedFragmentPtr find(FragmentId fragment) const = 0;
+    virtual void store(FragmentId fragment, ResolvedFragmentPtr value) = 0;
+};
+
+// Per-call evaluation state: the error path and the memo of evaluated
+// fragments. Create one for each resolve; never share one between threads.
 class EvaluationContext {
-    std::vector<std::string> path_;
+public:
+    // One step of the error path. Names are borrowed, not copied, and
+    // indices are kept as numbers, so tracking the path allocates nothing;
+    // the text is only built by path_string() when an error is reported.
+    struct PathComponent {
+        enum class Kind : uint8_t { Name, Index, Template };
+
+        const std::string* name;  // For Name and Template
+        size_t index;             // For Index
+        Kind kind;
+    };
+
+private:
+    std::vector<PathComponent> path_;
+    const CompiledFragments* compiled_ = nullptr;
+    FragmentResultCache* cache_ = nullptr;
+    const FragmentSource* source_ = nullptr;
+    ResolveStats* stats_ = nullptr;
+    std::unique_ptr<ResolveStats> fork_stats_;  // A fork's own, merged when it ends
+    std::unordered_map<FragmentId, ResolvedFragmentPtr> memo_;
+    const EvaluationContext* parent_ = nullptr;
+    bool consume_literals_ = false;  // Not inherited by forks
+    ResolveBudget* budget_ = nullptr;
+    size_t depth_ = 0;               // Fragments being evaluated one inside another
+    
+    // Value and key stacks of the bytecode engine. Nested programs share
+    // them, each working above the entries of the program that called it.
+    std::vector<nlohmann::json> value_stack_;
+    std::vector<const std::string*> key_stack_;  // Borrowed from programs or computed_keys_
+    std::deque<std::string> computed_keys_;      // A deque, so keys stay put as it grows
+    
+    // Counts a fragment being evaluated inside the current one, once the
+    // budget's deadline and depth allow it
+    struct Nesting {
+        size_t& depth;
+        Nesting(size_t& d, const ResolveBudget* budget) : depth(d) {
+            if (budget) {
+                budget->check_deadline();
+                budget->check_depth(depth + 1);
+            }
+            ++depth;
+        }
+        ~Nesting() { --depth; }
+    };
+
+    struct ForkTag {};
+    EvaluationContext(ForkTag, const EvaluationContext& parent)
+        : path_(parent.path_)
+        , compiled_(parent.compiled_)
+        , cache_(parent.cache_)
+        , source_(parent.source_)
+        , fork_stats_(parent.stats_ ? std::make_unique<ResolveStats>() : nullptr)
+        , parent_(&parent)
+        , budget_(parent.budget_)
+        , depth_(parent.depth_) {
+        stats_ = fork_stats_.get();
+        if (stats_) stats_->measure_output = parent.stats_->measure_output;
+    }
     
 public:
-    // Add element to the path
-    void push(const std::string& component) { 
-        path_.push_back(component); 
+    EvaluationContext() = default;
+
+    // Evaluate references against a set of compiled fragment trees,
+    // optionally reusing results kept across resolves. Names that were not
+    // compiled are looked up in source if given, else in the fragment map.
+    // Statistics, if given, are added to as evaluation goes.
+    explicit EvaluationContext(
+        const CompiledFragments& compiled,
+        FragmentResultCache* cache = nullptr,
+        const FragmentSource* source = nullptr,
+        ResolveStats* stats = nullptr
+    )
+        : compiled_(&compiled)
+        , cache_(cache)
+        , source_(source)
+        , stats_(stats) {}
+
+    EvaluationContext(const EvaluationContext&) = delete;
+    EvaluationContext& operator=(const EvaluationContext&) = delete;
+
+    // Forks may end on several threads at once
+    ~EvaluationContext() {
+        if (fork_stats_) {
+            static std::mutex merge_mutex;
+            std::lock_guard<std::mutex> lock(merge_mutex);
+            parent_->stats_->merge(*fork_stats_);
+        }
     }
+
+    // Creates a context for evaluating part of this one's subtree on another
+    // thread. The fork starts with this context's path and reads its memo,
+    // but records new results only in its own; this context must not be
+    // used to evaluate anything until all forks are finished.
+    EvaluationContext fork() const {
+        return EvaluationContext(ForkTag{}, *this);
+    }
+
+    // Add an object key or fragment name to the path. The string is not
+    // copied and must stay alive until the matching pop().
+    void push(const std::string& component) {
+        path_.push_back({&component, 0, PathComponent::Kind::Name});
+    }
+    void push(std::string&&) = delete;
+
+    // Add an array index to the path
+    void push_index(size_t index) {
+        path_.push_back({nullptr, index, PathComponent::Kind::Index});
+    }
+
+    // Add a template placeholder to the path, shown as "template:<name>"
+    void push_template(const std::string& fragment_name) {
+        path_.push_back({&fragment_name, 0, PathComponent::Kind::Template});
+    }
+    void push_template(std::string&&) = delete;
     
     // Remove last element from path
     void pop() { 
         if (!path_.empty()) path_.pop_back(); 
     }
     
-    // Get the current path for dependency tracking
-    const std::vector<std::string>& path() const { 
-        return path_; 
+    // Number of components in the current path
+    size_t path_depth() const {
+        return path_.size();
     }
     
+    std::vector<nlohmann::json>& value_stack() { return value_stack_; }
+    
+    // Statistics being collected, or nullptr
+    ResolveStats* stats() const { return stats_; }
+    
+    // Lets literal nodes move their values into the result rather than
+    // copy them. Only for a resolve that owns the fragments it parsed and
+    // evaluates each tree at most once.
+    void consume_literals() { consume_literals_ = true; }
+    bool consumes_literals() const { return consume_literals_; }
+    
+    // Checks evaluation against a budget from now on, if it has any limits
+    void set_budget(ResolveBudget& budget) { budget_ = budget.active() ? &budget : nullptr; }
+    
+    // The budget being checked, or nullptr
+    ResolveBudget* budget() const { return budget_; }
+    std::vector<const std::string*>& key_stack() { return key_stack_; }
+    std::deque<std::string>& computed_keys() { return computed_keys_; }
+    
     // Get string representation of path for error messages
     std::string path_string() const {
         std::string result;
         for (const auto& component : path_) {
-            result += "/" + component;
+            result += '/';
+            switch (component.kind) {
+                case PathComponent::Kind::Name:
+                    result += *component.name;
+                    break;
+                case PathComponent::Kind::Index:
+                    result += std::to_string(component.index);
+                    break;
+                case PathComponent::Kind::Template:
+                    result += "template:";
+                    result += *component.name;
+                    break;
+            }
         }
         return result.empty() ? "/" : result;
     }
     
+    // Resolves a fragment by ID, evaluating its compiled tree at most once
+    // per resolve. Fragments without a compiled tree are returned as-is.
+    // Returns nullptr if the fragment does not exist.
+    const nlohmann::json* resolve_fragment(
+        FragmentId fragment,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config
+    ) {
+        if (stats_) ++stats_->reference_lookups;
+        if (!compiled_ || fragment >= compiled_->sources.size()) {
+            return nullptr;
+        }
+
+        for (const EvaluationContext* ctx = this; ctx; ctx = ctx->parent_) {
+            auto memo_it = ctx->memo_.find(fragment);
+            if (memo_it != ctx->memo_.end()) {
+                if (stats_) ++stats_->memo_hits;
+                return memo_it->second.get();
+            }
+        }
+
+        const FragmentNode* node = compiled_->node(fragment);
+        if (!node) {
+            return compiled_->sources[fragment];
+        }
+        if (const nlohmann::json* constant = node->constant_value()) {
+            return constant;
+        }
+
+        ResolvedFragmentPtr value = cache_ ? cache_->find(fragment) : nullptr;
+        if (!value) {
+            value = std::make_shared<const nlohmann::json>(
+                evaluate_fragment(fragment, *node, fragments, config));
+            if (cache_) cache_->store(fragment, value);
+        } else if (stats_) {
+            ++stats_->cache_hits;
+        }
+        return memo_.emplace(fragment, std::move(value)).first->second.get();
+    }
+
+    // The value of a fragment this resolve has already evaluated, or nullptr
+    const nlohmann::json* memoized(FragmentId fragment) const {
+        for (const EvaluationContext* ctx = this; ctx; ctx = ctx->parent_) {
+            auto memo_it = ctx->memo_.find(fragment);
+            if (memo_it != ctx->memo_.end()) return memo_it->second.get();
+        }
+        return nullptr;
+    }
+
+    // Evaluates a fragment's tree, timing it when statistics are collected
+    nlohmann::json evaluate_fragment(
+        FragmentId fragment,
+        const FragmentNode& node,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config
+    ) {
+        Nesting nesting(depth_, budget_);
+
+        if (!stats_) {
+            return node.evaluate(fragments, config, *this);
+        }
+        auto start = std::chrono::steady_clock::now();
+        nlohmann::json value = node.evaluate(fragments, config, *this);
+        auto& entry = stats_->fragments[compiled_->symbols.name(fragment)];
+        ++entry.evaluations;
+        entry.time += std::chrono::steady_clock::now() - start;
+        if (stats_->measure_output) entry.output_bytes += value.dump().size();
+        return value;
+    }
+
+    // Evaluates only the part of a fragment's tree that path leads to,
+    // within the budget's depth and deadline as evaluate_fragment() is
+    nlohmann::json evaluate_fragment_at(
+        const FragmentNode& node,
+        const PointerPath& path,
+        size_t depth,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config
+    ) {
+        Nesting nesting(depth_, budget_);
+        return node.evaluate_at(path, depth, fragments, config, *this);
+    }
+
+    // Evaluates the tree returned by single_use_node() for a reference
+    nlohmann::json evaluate_single_use(
+        FragmentId fragment,
+        const FragmentNode& node,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config
+    ) {
+        if (stats_) ++stats_->reference_lookups;
+        return evaluate_fragment(fragment, node, fragments, config);
+    }
+
+    // The tree of a fragment that only one place in the compiled set refers
+    // to, when no result cache needs its value. The caller can evaluate it
+    // and move the result into place instead of copying it out of the memo.
+    const FragmentNode* single_use_node(FragmentId fragment) const {
+        if (!compiled_ || cache_ || fragment >= compiled_->reference_counts.size() ||
+            compiled_->reference_counts[fragment] != 1) {
+            return nullptr;
+        }
+        return compiled_->node(fragment);
+    }
+
+    // The compiled tree of a fragment, or nullptr if it has none
+    const FragmentNode* node(FragmentId fragment) const {
+        return compiled_ ? compiled_->node(fragment) : nullptr;
+    }
+
+    // Resolves a fragment whose name is only known during evaluation
+    const nlohmann::json* resolve_fragment(
+        const std::string& fragment_name,
+        const std::map<std::string, nlohmann::json>& fragments,
+        const JsonResolverConfig& config
+    ) {
+        if (compiled_) {
+            FragmentId fragment = compiled_->symbols.find(fragment_name);
+            if (fragment != SymbolTable::npos) {
+                return resolve_fragment(fragment, fragments, config);
+            }
+        }
+
+        if (source_) {
+            return source_->find(fragment_name);
+        }
+        auto it = fragments.find(fragment_name);
+        return it == fragments.end() ? nullptr : &it->second;
+    }
+
     // RAII helper for managing path components
     class ScopedComponent {
         EvaluationContext& context_;
     public:
+        // Tag for placeholder components
+        struct Template {
+            const std::string& fragment_name;
+        };
+
         ScopedComponent(EvaluationContext& context, const std::string& component)
             : context_(context) {
             context_.push(component);
         }
+        ScopedComponent(EvaluationContext& context, std::string&&) = delete;
+        ScopedComponent(EvaluationContext& context, size_t index)
+            : context_(context) {
+            context_.push_index(index);
+        }
+        ScopedComponent(EvaluationContext& context, Template placeholder)
+            : context_(context) {
+            context_.push_template(placeholder.fragment_name);
+        }
         ~ScopedComponent() { 
             context_.pop(); 
         }
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "flat_name_index.hpp"
+
+namespace json_fragments {
+
+// Where the resolver looks up raw fragment values by name. Lookups may be
+// served lazily, but a returned value must stay valid and unchanged for the
+// lifetime of the source. Implementations must be safe to call from several
+// threads at once.
+class FragmentSource {
+public:
+    virtual ~FragmentSource() = default;
+
+    // The value of a fragment, or nullptr if there is no such fragment
+    virtual const nlohmann::json* find(std::string_view name) const = 0;
+
+    // Calls visit with the name of every fragment
+    virtual void for_each_name(const std::function<void(const std::string&)>& visit) const = 0;
+};
+
+// Fragments held in a map. The map is not copied and must outlive the source.
+class MapFragmentSource : public FragmentSource {
+    const std::map<std::string, nlohmann::json>& fragments_;
+
+public:
+    explicit MapFragmentSource(const std::map<std::string, nlohmann::json>& fragments)
+        : fragments_(fragments) {}
+
+    const nlohmann::json* find(std::string_view name) const override {
+        auto it = fragments_.find(std::string(name));
+        return it == fragments_.end() ? nullptr : &it->second;
+    }
+
+    void for_each_name(const std::function<void(const std::string&)>& visit) const override {
+        for (const auto& entry : fragments_) {
+            visit(entry.first);
+        }
+    }
+};
+
+// Fragments held in a flat, open-addressing hash table. Entries are stored
+// contiguously in insertion order, and lookups take a string_view, hash it
+// once and probe adjacent slots, with no allocation and no tree walk. The
+// table must not be modified while a resolve is reading it.
+class FragmentTable : public FragmentSource {
+    using Entry = std::pair<std::string, nlohmann::json>;
+
+    std::vector<Entry> entries_;
+    FlatNameIndex index_;
+
+    struct NameAt {
+        const std::vector<Entry>& entries;
+        std::string_view operator()(uint32_t position) const { return entries[position].first; }
+    };
+
+public:
+    FragmentTable() = default;
+
+    explicit FragmentTable(const std::map<std::string, nlohmann::json>& fragments) {
+        reserve(fragments.size());
+        for (const auto& [name, value] : fragments) {
+            insert_or_assign(name, value);
+        }
+    }
+
+    explicit FragmentTable(const std::unordered_map<std::string, nlohmann::json>& fragments) {
+        reserve(fragments.size());
+        for (const auto& [name, value] : fragments) {
+            insert_or_assign(name, value);
+        }
+    }
+
+    // Adds a fragment, or replaces the value of one with the same name
+    void insert_or_assign(std::string name, nlohmann::json value) {
+        uint32_t position = index_.find(name, NameAt{entries_});
+        if (position != FlatNameIndex::npos) {
+            entries_[position].second = std::move(value);
+            return;
+        }
+        index_.insert(name, static_cast<uint32_t>(entries_.size()));
+        entries_.emplace_back(std::move(name), std::move(value));
+    }
+
+    // Makes room for count fragments
+    void reserve(size_t count) {
+        entries_.reserve(count);
+        index_.reserve(count);
+    }
+
+    const nlohmann::json* find(std::string_view name) const override {
+        uint32_t position = index_.find(name, NameAt{entries_});
+        return position == FlatNameIndex::npos ? nullptr : &entries_[position].second;
+    }
+
+    void for_each_name(const std::function<void(const std::string&)>& visit) const override {
+        for (const auto& entry : entries_) {
+            visit(entry.first);
+        }
+    }
+
+    size_t size() const { return entries_.size(); }
+};
+
+// Fragments stored as the members of one top-level JSON object in a file.
+// The file is memory-mapped and scanned once to record where each member's
+// value starts and ends; a value is only parsed the first time it is looked
+// up, so only the fragments a resolve actually reaches are ever parsed.
+// Later duplicates of a name replace earlier ones, as when parsing the file.
+class MappedFragmentFile : public FragmentSource {
+public:
+    // Maps and indexes a file. Throws FragmentSourceError if the file cannot
+    // be read or its top level is not a well-formed JSON object.
+    explicit MappedFragmentFile(const std::string& path);
+    ~MappedFragmentFile() override;
+
+    MappedFragmentFile(const MappedFragmentFile&) = delete;
+    MappedFragmentFile& operator=(const MappedFragmentFile&) = delete;
+
+    // Parses the fragment on first use. Throws FragmentSourceError if its
+    // value is not valid JSON.
+    const nlohmann::json* find(std::string_view name) const override;
+
+    void for_each_name(const std::function<void(const std::string&)>& visit) const override;
+
+    // Number of fragments in the file
+    size_t size() const;
+
+    // Number of fragments parsed so far
+    size_t parsed_count() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace json_fragments
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "fragment_nodes.hpp"
+
+namespace json_fragments {
+
+// A fragment set that can be changed one fragment at a time. Resolved
+// fragments are cached across calls; update_fragment() re-parses only the
+// changed fragment and drops only the cached results that depend on it,
+// directly or transitively, so they are re-evaluated on next access.
+//
+// Dependencies are those visible at parse time. With TemplateExpansion::Nested,
+// references composed during expansion are not tracked and may stay stale.
+//
+// resolve() may be called from several threads at once; updates wait for
+// running resolves to finish and block new ones until they are applied.
+class IncrementalResolver {
+public:
+    explicit IncrementalResolver(
+        std::map<std::string, nlohmann::json> fragments,
+        JsonResolverConfig config = {}
+    );
+    ~IncrementalResolver();
+
+    IncrementalResolver(const IncrementalResolver&) = delete;
+    IncrementalResolver& operator=(const IncrementalResolver&) = delete;
+
+    // Resolves a fragment, reusing cached results wherever still valid
+    nlohmann::json resolve(const std::string& start_fragment) const;
+
+    // Resolves a fragment into a shared, immutable result. With a result
+    // cache in the config, whole results are reused until the next update.
+    ResolvedFragmentPtr resolve_shared(const std::string& start_fragment) const;
+
+    // Replaces or adds a fragment. Throws CircularDependencyError, leaving
+    // the set unchanged, if the new value would create a cycle.
+    void update_fragment(const std::string& fragment_name, nlohmann::json value);
+
+    // Removes a fragment; references to it become missing references
+    void remove_fragment(const std::string& fragment_name);
+
+    // Number of fragments whose resolved value is currently cached. Fragments
+    // without references resolve to their own value and are never cached.
+    size_t cached_fragment_count() const;
+
+    // Number of successful updates and removals so far
+    uint64_t generation() const;
+
+    const JsonResolverConfig& config() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace json_fragments
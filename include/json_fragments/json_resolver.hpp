@@ -1,27 +1,144 @@
 #pragma once
 
+#include <future>
 #include <map>
+#include <ostream>
 #include <set>
 #include <string>
+#include <vector>
 #include <nlohmann/json.hpp>
+#include "async_fragment_provider.hpp"
 #include "fragment_nodes.hpp"
+#include "fragment_source.hpp"
+#include "resolve_stats.hpp"
+#include "static_delimiters.hpp"
+#include "compiled_fragment_set.hpp"
 
 namespace json_fragments {
 
-class JsonResolver {
+// Resolves fragments whose references use Delimiters. With the default,
+// ConfiguredDelimiters, the delimiters come from the configuration, and
+// parsing still takes the compile-time path when they are one of the
+// built-in sets. A compile-time set such as BracketDelimiters replaces any
+// delimiters in the configuration. Instantiated for ConfiguredDelimiters,
+// BracketDelimiters and DoubleBraceDelimiters.
+template <typename Delimiters = ConfiguredDelimiters>
+class BasicJsonResolver {
 public:
-    explicit JsonResolver(JsonResolverConfig config = {});
-    ~JsonResolver();
+    explicit BasicJsonResolver(JsonResolverConfig config = {});
+    ~BasicJsonResolver();
 
-    // Main entry point - resolves a fragment and all its dependencies
+    // Main entry point - resolves a fragment and all its dependencies.
+    // Safe to call concurrently; all evaluation state is per call. Work
+    // done by the call is added to stats if given.
     nlohmann::json resolve(
         const std::map<std::string, nlohmann::json>& fragments,
-        const std::string& start_fragment
-    );
+        const std::string& start_fragment,
+        ResolveStats* stats = nullptr
+    ) const;
+
+    // Resolves a fragment from a map the caller gives up. Values without
+    // references are moved from the map into the result instead of being
+    // copied, by either evaluation engine; the map is left valid but
+    // unspecified. Fragments referred to
+    // more than once are still copied, as are all values when parallel
+    // evaluation or nested template expansion is configured, since either
+    // may read a fragment after its value was moved.
+    nlohmann::json resolve(
+        std::map<std::string, nlohmann::json>&& fragments,
+        const std::string& start_fragment,
+        ResolveStats* stats = nullptr
+    ) const;
+
+    // Resolves a fragment and writes it to a stream as compact JSON while
+    // evaluating, without building the whole document first. The output
+    // matches resolve(fragments, start).dump(); on failure, part of it
+    // may already have been written.
+    void resolve_to(
+        const std::map<std::string, nlohmann::json>& fragments,
+        const std::string& start_fragment,
+        std::ostream& out,
+        ResolveStats* stats = nullptr
+    ) const;
+
+    // Resolves a fragment from a source such as a MappedFragmentFile. Only
+    // the start fragment and the fragments it reaches are looked up, so a
+    // lazy source parses nothing else.
+    nlohmann::json resolve(
+        const FragmentSource& source,
+        const std::string& start_fragment,
+        ResolveStats* stats = nullptr
+    ) const;
+
+    // Streams a fragment from a source, as resolve_to() does for a map
+    void resolve_to(
+        const FragmentSource& source,
+        const std::string& start_fragment,
+        std::ostream& out,
+        ResolveStats* stats = nullptr
+    ) const;
+
+    // Resolves only the value a JSON pointer names inside a start
+    // fragment's document. Evaluation follows the pointer through objects,
+    // arrays and references and evaluates just the subtree it ends at;
+    // every fragment the start reaches is still parsed and checked for
+    // cycles. Throws PointerNotFoundError if the pointer leads nowhere.
+    nlohmann::json resolve_at(
+        const std::map<std::string, nlohmann::json>& fragments,
+        const std::string& start_fragment,
+        const nlohmann::json::json_pointer& pointer,
+        ResolveStats* stats = nullptr
+    ) const;
+
+    // Resolves the value at a JSON pointer from a source
+    nlohmann::json resolve_at(
+        const FragmentSource& source,
+        const std::string& start_fragment,
+        const nlohmann::json::json_pointer& pointer,
+        ResolveStats* stats = nullptr
+    ) const;
+
+    // Resolves a fragment whose fragments are fetched from a provider,
+    // returning at once. The start fragment is fetched first; each fetched
+    // fragment is parsed as it arrives, and the names it refers to that
+    // have not been asked for yet are fetched together as one batch while
+    // earlier batches are still in flight. Evaluation starts once nothing
+    // is outstanding; names only found while evaluating, as nested
+    // template expansion can produce, are fetched and evaluation is run
+    // again. The provider, and stats if given, must outlive the future.
+    std::future<nlohmann::json> resolve_async(
+        AsyncFragmentProvider& provider,
+        const std::string& start_fragment,
+        ResolveStats* stats = nullptr
+    ) const;
+
+    // Resolves several start fragments in one call, returning results in
+    // the same order. The fragments reachable from any start are parsed
+    // once, and shared dependencies are evaluated once per worker; with a
+    // pool, the starts are spread across its threads.
+    std::vector<nlohmann::json> resolve_many(
+        const std::map<std::string, nlohmann::json>& fragments,
+        const std::vector<std::string>& start_fragments,
+        ThreadPool* pool = nullptr
+    ) const;
+
+    // Parses every fragment once into a reusable set that can be resolved
+    // repeatedly with different start fragments, on a pool's threads if given
+    CompiledFragmentSet compile(
+        std::map<std::string, nlohmann::json> fragments,
+        ThreadPool* pool = nullptr
+    ) const;
+
+    const JsonResolverConfig& config() const { return config_; }
 
 private:
     JsonResolverConfig config_;
-    EvaluationContext context_;
 };
 
+using JsonResolver = BasicJsonResolver<>;
+
+extern template class BasicJsonResolver<ConfiguredDelimiters>;
+extern template class BasicJsonResolver<BracketDelimiters>;
+extern template class BasicJsonResolver<DoubleBraceDelimiters>;
+
 } // namespace json_fragments
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace json_fragments {
+
+// Writes compact JSON to a stream piece by piece, producing the same text
+// as nlohmann::json::dump() of the equivalent document
+class JsonWriter {
+    using Serializer = nlohmann::detail::serializer<nlohmann::json>;
+
+    std::ostream& out_;
+    Serializer serializer_;
+    std::vector<bool> first_;   // Per open container: nothing written yet
+    bool after_key_ = false;
+
+public:
+    explicit JsonWriter(std::ostream& out)
+        : out_(out)
+        , serializer_(nlohmann::detail::output_adapter<char>(out), ' ') {}
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    void begin_object() {
+        separate();
+        out_.put('{');
+        first_.push_back(true);
+    }
+
+    void end_object() {
+        first_.pop_back();
+        out_.put('}');
+    }
+
+    void begin_array() {
+        separate();
+        out_.put('[');
+        first_.push_back(true);
+    }
+
+    void end_array() {
+        first_.pop_back();
+        out_.put(']');
+    }
+
+    // Writes an object key; the next value written belongs to it
+    void key(std::string key) {
+        separate();
+        serializer_.dump(nlohmann::json(std::move(key)), false, false, 0);
+        out_.put(':');
+        after_key_ = true;
+    }
+
+    void value(const nlohmann::json& value) {
+        separate();
+        serializer_.dump(value, false, false, 0);
+    }
+
+    // Writes a value that is already serialized
+    void raw(std::string_view serialized) {
+        separate();
+        out_.write(serialized.data(), static_cast<std::streamsize>(serialized.size()));
+    }
+
+private:
+    void separate() {
+        if (after_key_) {
+            after_key_ = false;
+        } else if (!first_.empty()) {
+            if (!first_.back()) out_.put(',');
+            first_.back() = false;
+        }
+    }
+};
+
+} // namespace json_fragments
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace json_fragments {
+
+// Fixed-length view of objects stored in a NodeArena
+template <typename T>
+class ArenaArray {
+    T* data_ = nullptr;
+    size_t size_ = 0;
+
+public:
+    ArenaArray() = default;
+    ArenaArray(T* data, size_t size) : data_(data), size_(size) {}
+
+    T* begin() const { return data_; }
+    T* end() const { return data_ + size_; }
+    T& operator[](size_t i) const { return data_[i]; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+};
+
+// Monotonic bump allocator for fragment trees. Objects are carved out of
+// large blocks and never freed one by one; the arena releases every block
+// at once when it is destroyed. Only objects with non-trivial destructors
+// are remembered and destroyed, so trees built from trivially destructible
+// nodes are torn down without visiting them. Moving an arena keeps every
+// object at its address.
+class NodeArena {
+    static constexpr size_t block_size = 64 * 1024;
+
+    // Destructors to run on teardown, linked newest first
+    struct Cleanup {
+        void (*destroy)(void*);
+        void* object;
+        Cleanup* next;
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks_;
+    std::byte* cursor_ = nullptr;
+    std::byte* limit_ = nullptr;
+    Cleanup* cleanups_ = nullptr;
+    size_t bytes_used_ = 0;
+
+public:
+    NodeArena() = default;
+
+    NodeArena(NodeArena&& other) noexcept
+        : blocks_(std::move(other.blocks_))
+        , cursor_(std::exchange(other.cursor_, nullptr))
+        , limit_(std::exchange(other.limit_, nullptr))
+        , cleanups_(std::exchange(other.cleanups_, nullptr))
+        , bytes_used_(std::exchange(other.bytes_used_, 0)) {}
+
+    NodeArena& operator=(NodeArena&& other) noexcept {
+        if (this != &other) {
+            destroy_all();
+            blocks_ = std::move(other.blocks_);
+            cursor_ = std::exchange(other.cursor_, nullptr);
+            limit_ = std::exchange(other.limit_, nullptr);
+            cleanups_ = std::exchange(other.cleanups_, nullptr);
+            bytes_used_ = std::exchange(other.bytes_used_, 0);
+        }
+        return *this;
+    }
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    ~NodeArena() { destroy_all(); }
+
+    // Constructs an object in the arena. It lives until the arena is destroyed.
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        void* memory = allocate(sizeof(T), alignof(T));
+        if constexpr (std::is_trivially_destructible_v<T>) {
+            return new (memory) T(std::forward<Args>(args)...);
+        } else {
+            // Reserve the cleanup record first so a failed allocation cannot
+            // leave a constructed object without one
+            void* record = allocate(sizeof(Cleanup), alignof(Cleanup));
+            T* object = new (memory) T(std::forward<Args>(args)...);
+            cleanups_ = new (record) Cleanup{
+                [](void* p) { static_cast<T*>(p)->~T(); }, object, cleanups_};
+            return object;
+        }
+    }
+
+    // Allocates an array of value-initialized objects
+    template <typename T>
+    ArenaArray<T> make_array(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "arena arrays are never destroyed");
+        if (count == 0) return {};
+        T* data = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        std::uninitialized_value_construct_n(data, count);
+        return {data, count};
+    }
+
+    // Copies characters into arena storage
+    std::string_view copy_string(std::string_view text) {
+        if (text.empty()) return {};
+        auto* data = static_cast<char*>(allocate(text.size(), alignof(char)));
+        std::memcpy(data, text.data(), text.size());
+        return {data, text.size()};
+    }
+
+    // Takes over every object of another arena, leaving it empty. Objects
+    // keep their addresses; the other arena's unused space is not reused.
+    void adopt(NodeArena&& other) {
+        for (auto& block : other.blocks_) {
+            blocks_.push_back(std::move(block));
+        }
+        other.blocks_.clear();
+        if (other.cleanups_) {
+            Cleanup* last = other.cleanups_;
+            while (last->next) last = last->next;
+            last->next = cleanups_;
+            cleanups_ = std::exchange(other.cleanups_, nullptr);
+        }
+        bytes_used_ += std::exchange(other.bytes_used_, 0);
+        other.cursor_ = other.limit_ = nullptr;
+    }
+
+    // Bytes handed out so far, including alignment padding
+    size_t bytes_used() const { return bytes_used_; }
+
+private:
+    void* allocate(size_t size, size_t alignment) {
+        auto space = static_cast<size_t>(limit_ - cursor_);
+        void* memory = cursor_;
+        if (!cursor_ || !std::align(alignment, size, memory, space)) {
+            // Oversized requests get a block of their own
+            size_t capacity = std::max(block_size, size + alignment);
+            blocks_.emplace_back(new std::byte[capacity]);
+            cursor_ = blocks_.back().get();
+            limit_ = cursor_ + capacity;
+            memory = cursor_;
+            space = capacity;
+            std::align(alignment, size, memory, space);
+        }
+        auto* start = static_cast<std::byte*>(memory);
+        bytes_used_ += static_cast<size_t>(start + size - cursor_);
+        cursor_ = start + size;
+        return memory;
+    }
+
+    void destroy_all() {
+        for (Cleanup* cleanup = cleanups_; cleanup; cleanup = cleanup->next) {
+            cleanup->destroy(cleanup->object);
+        }
+        cleanups_ = nullptr;
+        blocks_.clear();
+        cursor_ = limit_ = nullptr;
+        bytes_used_ = 0;
+    }
+};
+
+} // namespace json_fragments
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "exceptions.hpp"
+
+namespace json_fragments {
+
+// Bounds on the work of a single resolve, for inputs that cannot be
+// trusted. Zero means no limit. A resolve that reaches a limit throws
+// ResourceLimitError. Only the parse a resolve does itself is bounded, so
+// nodes and parse depth are not checked for a CompiledFragmentSet.
+struct ResolveLimits {
+    // Scans of one template's text under nested expansion
+    size_t max_template_passes = 0;
+
+    // Text built while evaluating: expanded templates, literal values
+    // copied or moved into the output, and fragments that are copied
+    // because more than one place refers to them. Values count their
+    // strings and keys in bytes, and every other value as one byte.
+    size_t max_output_bytes = 0;
+
+    // Nodes created while parsing
+    size_t max_nodes = 0;
+
+    // Fragments being parsed or evaluated one inside another
+    size_t max_depth = 0;
+
+    // Wall-clock time from the start of the resolve, checked each time a
+    // fragment is parsed or evaluated and on every template pass
+    std::chrono::nanoseconds time_limit{0};
+
+    bool any() const {
+        return max_template_passes || max_output_bytes || max_nodes || max_depth ||
+               time_limit.count() > 0;
+    }
+};
+
+// The work one resolve has done against its limits. Shared by the parser
+// and by every evaluation context of the resolve, forks included, so the
+// counters are atomic. Parsers and contexts hold a null budget when no
+// limit is set, so unlimited resolves pay one untaken branch per check.
+class ResolveBudget {
+    const ResolveLimits& limits_;
+    std::chrono::steady_clock::time_point deadline_;
+    std::atomic<size_t> output_bytes_{0};
+    std::atomic<size_t> nodes_{0};
+
+public:
+    explicit ResolveBudget(const ResolveLimits& limits)
+        : limits_(limits) {
+        if (limits_.time_limit.count() > 0) {
+            deadline_ = std::chrono::steady_clock::now() +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(limits_.time_limit);
+        }
+    }
+
+    ResolveBudget(const ResolveBudget&) = delete;
+    ResolveBudget& operator=(const ResolveBudget&) = delete;
+
+    // Whether any limit is set; parsers and contexts ignore budgets without
+    bool active() const { return limits_.any(); }
+
+    void add_nodes(size_t count) {
+        if (limits_.max_nodes && nodes_.fetch_add(count) + count > limits_.max_nodes) {
+            throw ResourceLimitError("more than " + std::to_string(limits_.max_nodes) + " nodes");
+        }
+    }
+
+    void add_output(size_t bytes) {
+        if (limits_.max_output_bytes &&
+            output_bytes_.fetch_add(bytes) + bytes > limits_.max_output_bytes) {
+            throw ResourceLimitError(
+                "more than " + std::to_string(limits_.max_output_bytes) + " output bytes");
+        }
+    }
+
+    // Counts a value copied into the output, walking it only when output
+    // bytes are limited
+    void add_copy(const nlohmann::json& value) {
+        if (limits_.max_output_bytes) add_output(output_size(value));
+    }
+
+    void check_depth(size_t depth) const {
+        if (limits_.max_depth && depth > limits_.max_depth) {
+            throw ResourceLimitError("nesting deeper than " + std::to_string(limits_.max_depth));
+        }
+    }
+
+    void check_passes(size_t passes) const {
+        if (limits_.max_template_passes && passes > limits_.max_template_passes) {
+            throw ResourceLimitError(
+                "more than " + std::to_string(limits_.max_template_passes) + " template passes");
+        }
+    }
+
+    void check_deadline() const {
+        if (limits_.time_limit.count() > 0 && std::chrono::steady_clock::now() > deadline_) {
+            throw ResourceLimitError("time limit reached");
+        }
+    }
+
+    // When the time limit runs out, or the latest representable time
+    // without one, for waiting on work outside the resolve
+    std::chrono::steady_clock::time_point deadline() const {
+        return limits_.time_limit.count() > 0 ? deadline_ : std::chrono::steady_clock::time_point::max();
+    }
+
+    // Size of a value as max_output_bytes counts it
+    static size_t output_size(const nlohmann::json& value) {
+        switch (value.type()) {
+            case nlohmann::json::value_t::string:
+                return value.get_ref<const std::string&>().size();
+            case nlohmann::json::value_t::object: {
+                size_t size = 1;
+                for (auto it = value.begin(); it != value.end(); ++it) {
+                    size += it.key().size() + output_size(it.value());
+                }
+                return size;
+            }
+            case nlohmann::json::value_t::array: {
+                size_t size = 1;
+                for (const auto& element : value) size += output_size(element);
+                return size;
+            }
+            default:
+                return 1;
+        }
+    }
+};
+
+} // namespace json_fragments
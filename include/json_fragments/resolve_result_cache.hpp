@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "fragment_nodes.hpp"
+
+namespace json_fragments {
+
+// Bounded, least-recently-used cache of whole resolve results, shared by
+// any number of compiled sets and incremental resolvers through
+// JsonResolverConfig::result_cache. Unlike FragmentResultCache, which keeps
+// the values of individual fragments within one set, entries here are
+// complete results keyed by the fragment set's generation, the start
+// fragment and a hash of the configuration that shapes results, so a hit
+// skips evaluation entirely. Results are shared and immutable; the cache
+// is safe to use from several threads at once.
+class ResolveResultCache {
+public:
+    struct Key {
+        uint64_t generation;        // From new_generation(), unique per fragment set version
+        std::string start_fragment;
+        size_t config_hash;         // From config_hash()
+
+        bool operator==(const Key& other) const {
+            return generation == other.generation && config_hash == other.config_hash &&
+                   start_fragment == other.start_fragment;
+        }
+    };
+
+    // Keeps at most capacity results, dropping the least recently used
+    explicit ResolveResultCache(size_t capacity);
+
+    ResolveResultCache(const ResolveResultCache&) = delete;
+    ResolveResultCache& operator=(const ResolveResultCache&) = delete;
+
+    // The cached result for a key, or nullptr. Marks it as recently used.
+    ResolvedFragmentPtr find(const Key& key);
+
+    // Adds or replaces the result for a key
+    void store(Key key, ResolvedFragmentPtr value);
+
+    void clear();
+
+    size_t size() const;
+    size_t capacity() const { return capacity_; }
+
+    // Lookups answered and not answered so far
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+    // A generation number no other fragment set version has used. Compiled
+    // sets take one when built; incremental resolvers take a new one on
+    // every update, so results from before the update are never returned.
+    static uint64_t new_generation();
+
+    // Hash of the configuration fields that affect resolved values:
+    // delimiters, missing fragment behavior, default value and template
+    // expansion. The engine and parallel settings do not change results.
+    static size_t config_hash(const JsonResolverConfig& config);
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    using Entry = std::pair<Key, ResolvedFragmentPtr>;
+
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    std::list<Entry> entries_;  // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
+
+} // namespace json_fragments
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace json_fragments {
+
+// Counters and timings collected by a resolve that is given a ResolveStats.
+// Resolves add to the counters, so one object can total several calls.
+// Without one, each instrumentation point costs a single untaken branch.
+struct ResolveStats {
+    // Nodes created while parsing, by type
+    size_t literal_nodes = 0;
+    size_t reference_nodes = 0;
+    size_t template_nodes = 0;
+    size_t object_nodes = 0;
+    size_t array_nodes = 0;
+
+    // Fragments entered by the dependency tracker's cycle check
+    size_t cycle_check_visits = 0;
+
+    // References followed during evaluation, template placeholders included
+    size_t reference_lookups = 0;
+    size_t memo_hits = 0;               // Answered by this resolve's memo
+    size_t cache_hits = 0;              // Answered by a FragmentResultCache
+    size_t value_copies = 0;            // Resolved values copied out rather than moved
+
+    size_t template_substitutions = 0;  // Placeholders replaced in templates
+    size_t template_passes = 0;         // Scans over template text
+
+    // String bytes copied: template and literal text into the node arena,
+    // and the text of expanded templates
+    size_t bytes_copied = 0;
+
+    std::chrono::nanoseconds parse_time{0};
+    std::chrono::nanoseconds evaluate_time{0};
+
+    // Per evaluated fragment. Times include the fragments it refers to
+    // that were evaluated for the first time on its behalf.
+    struct Fragment {
+        size_t evaluations = 0;
+        std::chrono::nanoseconds time{0};
+        size_t output_bytes = 0;        // Only with measure_output
+    };
+    std::map<std::string, Fragment> fragments;
+
+    // Also record the size of each evaluated fragment's compact JSON. Each
+    // value is serialized once more to measure it, outside its timing, so
+    // this is for profiling rather than for production resolves.
+    bool measure_output = false;
+
+    // Names of up to count fragments with the most evaluation time, most
+    // first
+    std::vector<std::string> hottest(size_t count) const {
+        std::vector<const std::pair<const std::string, Fragment>*> entries;
+        entries.reserve(fragments.size());
+        for (const auto& entry : fragments) entries.push_back(&entry);
+        count = std::min(count, entries.size());
+        std::partial_sort(entries.begin(), entries.begin() + count, entries.end(),
+            [](const auto* a, const auto* b) {
+                if (a->second.time != b->second.time) return a->second.time > b->second.time;
+                return a->first < b->first;
+            });
+
+        std::vector<std::string> names;
+        names.reserve(count);
+        for (size_t i = 0; i < count; ++i) names.push_back(entries[i]->first);
+        return names;
+    }
+
+    // Adds another set of statistics to this one
+    void merge(const ResolveStats& other) {
+        literal_nodes += other.literal_nodes;
+        reference_nodes += other.reference_nodes;
+        template_nodes += other.template_nodes;
+        object_nodes += other.object_nodes;
+        array_nodes += other.array_nodes;
+        cycle_check_visits += other.cycle_check_visits;
+        reference_lookups += other.reference_lookups;
+        memo_hits += other.memo_hits;
+        cache_hits += other.cache_hits;
+        value_copies += other.value_copies;
+        template_substitutions += other.template_substitutions;
+        template_passes += other.template_passes;
+        bytes_copied += other.bytes_copied;
+        parse_time += other.parse_time;
+        evaluate_time += other.evaluate_time;
+        for (const auto& [name, fragment] : other.fragments) {
+            auto& total = fragments[name];
+            total.evaluations += fragment.evaluations;
+            total.time += fragment.time;
+            total.output_bytes += fragment.output_bytes;
+        }
+    }
+};
+
+// Adds the time from its construction to its destruction to a duration,
+// or does nothing when given nullptr
+class StatsTimer {
+    std::chrono::nanoseconds* total_;
+    std::chrono::steady_clock::time_point start_;
+
+public:
+    explicit StatsTimer(std::chrono::nanoseconds* total)
+        : total_(total) {
+        if (total_) start_ = std::chrono::steady_clock::now();
+    }
+    ~StatsTimer() {
+        if (total_) *total_ += std::chrono::steady_clock::now() - start_;
+    }
+
+    StatsTimer(const StatsTimer&) = delete;
+    StatsTimer& operator=(const StatsTimer&) = delete;
+};
+
+} // namespace json_fragments
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string_view>
+#include "fragment_nodes.hpp"
+
+namespace json_fragments {
+
+// Delimiter sets fixed at compile time. Parsers specialized for one of
+// them search for constant delimiters, so single characters are found with
+// memchr and compared byte by byte, and the scanning path inlines.
+
+// The default [name] delimiters
+struct BracketDelimiters {
+    static constexpr std::string_view start = "[";
+    static constexpr std::string_view end = "]";
+};
+
+// Mustache-style {{name}} delimiters
+struct DoubleBraceDelimiters {
+    static constexpr std::string_view start = "{{";
+    static constexpr std::string_view end = "}}";
+};
+
+// Delimiters read from JsonResolverConfig at run time
+struct ConfiguredDelimiters {};
+
+// Whether a configuration uses a compile-time delimiter set
+template <typename Delimiters>
+bool uses_delimiters(const JsonResolverConfig& config) {
+    return config.delimiters.start == Delimiters::start && config.delimiters.end == Delimiters::end;
+}
+
+} // namespace json_fragments
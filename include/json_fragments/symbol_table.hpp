@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include "flat_name_index.hpp"
+
+namespace json_fragments {
+
+// Dense integer handle for an interned fragment name
+using FragmentId = uint32_t;
+
+// Interns fragment names so that each name is stored once and referred to
+// everywhere else by a dense FragmentId. IDs are handed out in interning
+// order starting at zero, so they can index flat vectors directly.
+class SymbolTable {
+    // A deque keeps the stored names at stable addresses, so any name
+    // references handed out stay valid as the table grows
+    std::deque<std::string> names_;
+    FlatNameIndex ids_;
+
+public:
+    static constexpr FragmentId npos = FlatNameIndex::npos;
+
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+    SymbolTable(SymbolTable&&) = default;
+    SymbolTable& operator=(SymbolTable&&) = default;
+
+    // Returns the ID for a name, assigning the next free ID if it is new
+    FragmentId intern(std::string_view name) {
+        FragmentId id = find(name);
+        if (id != npos) {
+            return id;
+        }
+
+        id = static_cast<FragmentId>(names_.size());
+        names_.emplace_back(name);
+        ids_.insert(name, id);
+        return id;
+    }
+
+    // Returns the ID for a name, or npos if it was never interned
+    FragmentId find(std::string_view name) const {
+        return ids_.find(name, [this](FragmentId id) -> std::string_view { return names_[id]; });
+    }
+
+    // The name behind an ID; the reference stays valid for the table's lifetime
+    const std::string& name(FragmentId id) const { return names_[id]; }
+
+    size_t size() const { return names_.size(); }
+};
+
+} // namespace json_fragments
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace json_fragments {
+
+// Fixed-size pool of worker threads for spreading resolves across cores.
+// parallel_for() runs part of the work on the calling thread and never waits
+// for helpers that have not started yet, so it may be called from inside a
+// pool task without risking deadlock.
+class ThreadPool {
+public:
+    // Creates a pool with the given number of worker threads; zero means
+    // one per hardware thread
+    explicit ThreadPool(size_t threads = 0) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        workers_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this] { run_worker(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of worker threads, not counting callers of parallel_for()
+    size_t size() const { return workers_.size(); }
+
+    // Calls body(i) for every i in [0, count) using the pool and the calling
+    // thread, and returns once all calls have finished. If any call throws,
+    // remaining indices are skipped and the first exception is rethrown.
+    template <typename Body>
+    void parallel_for(size_t count, Body&& body) {
+        if (count == 0) return;
+
+        auto job = std::make_shared<Job>();
+        job->count = count;
+        job->body = [&body](size_t i) { body(i); };
+
+        size_t helpers = std::min(count - 1, workers_.size());
+        for (size_t i = 0; i < helpers; ++i) {
+            submit([job] {
+                {
+                    std::lock_guard<std::mutex> lock(job->mutex);
+                    if (job->closed) return;
+                    ++job->active;
+                }
+                job->run();
+                std::lock_guard<std::mutex> lock(job->mutex);
+                if (--job->active == 0) job->done.notify_all();
+            });
+        }
+
+        job->run();
+
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->closed = true;
+        job->done.wait(lock, [&] { return job->active == 0; });
+        if (job->error) {
+            std::rethrow_exception(job->error);
+        }
+    }
+
+private:
+    // State shared between a parallel_for() caller and its helpers. Helpers
+    // that start after the caller has closed the job leave without touching
+    // body, which refers to the caller's stack.
+    struct Job {
+        std::atomic<size_t> next{0};
+        size_t count = 0;
+        std::function<void(size_t)> body;
+
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t active = 0;
+        bool closed = false;
+        std::exception_ptr error;
+
+        void run() {
+            for (size_t i = next++; i < count; i = next++) {
+                try {
+                    body(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error) error = std::current_exception();
+                    next = count;
+                }
+            }
+        }
+    };
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        wake_.notify_one();
+    }
+
+    void run_worker() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty()) return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+};
+
+} // namespace json_fragments
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "json_fragments/fragment_nodes.hpp"
+#include "json_fragments/exceptions.hpp"
+#include "json_fragments/thread_pool.hpp"
+
+namespace json_fragments {
+
+// Resolves several start fragments against one set of compiled trees.
+// Starts resolved by the same context share its memo, so dependencies common
+// to several starts are evaluated once per context. With a pool, starts are
+// split into one contiguous chunk per thread, each with its own context.
+// The whole batch counts against one budget.
+inline std::vector<nlohmann::json> resolve_batch(
+    const CompiledFragments& compiled,
+    const std::map<std::string, nlohmann::json>& fragments,
+    const JsonResolverConfig& config,
+    const std::vector<std::string>& start_fragments,
+    ThreadPool* pool,
+    ResolveBudget& budget
+) {
+    std::vector<FragmentId> roots;
+    roots.reserve(start_fragments.size());
+    for (const auto& start_fragment : start_fragments) {
+        FragmentId root = compiled.symbols.find(start_fragment);
+        if (!compiled.node(root)) {
+            throw FragmentNotFoundError(start_fragment);
+        }
+        roots.push_back(root);
+    }
+
+    std::vector<nlohmann::json> results(roots.size());
+    auto resolve_range = [&](size_t begin, size_t end) {
+        EvaluationContext context(compiled);
+        context.set_budget(budget);
+        for (size_t i = begin; i < end; ++i) {
+            EvaluationContext::ScopedComponent path_component(context, start_fragments[i]);
+            results[i] = *context.resolve_fragment(roots[i], fragments, config);
+        }
+    };
+
+    if (!pool || pool->size() == 0 || roots.size() < 2) {
+        resolve_range(0, roots.size());
+        return results;
+    }
+
+    size_t chunks = std::min(roots.size(), pool->size() + 1);
+    pool->parallel_for(chunks, [&](size_t chunk) {
+        resolve_range(chunk * roots.size() / chunks, (chunk + 1) * roots.size() / chunks);
+    });
+    return results;
+}
+
+} // namespace json_fragments
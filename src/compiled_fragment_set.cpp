@@ -0,0 +1,148 @@
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/exceptions.hpp"
+#include "fragment_parser.hpp"
+#include "batch_resolve.hpp"
+
+namespace json_fragments {
+
+CompiledFragmentSet::CompiledFragmentSet(
+    std::map<std::string, nlohmann::json> fragments,
+    JsonResolverConfig config,
+    ThreadPool* pool
+)
+    : config_(std::move(config))
+    , generation_(ResolveResultCache::new_generation())
+    , config_hash_(ResolveResultCache::config_hash(config_))
+    , fragments_(std::move(fragments)) {
+    compiled_ = with_delimiters(config_, [this, pool](auto delimiters) {
+        BasicFragmentParser<decltype(delimiters)> parser(config_, fragments_, true);
+        parser.compile_all(pool);
+        return parser.take_compiled();
+    });
+    size_ = fragments_.size();
+}
+
+CompiledFragmentSet::CompiledFragmentSet(
+    JsonResolverConfig config,
+    CompiledFragments compiled,
+    std::shared_ptr<const void> storage
+)
+    : config_(std::move(config))
+    , generation_(ResolveResultCache::new_generation())
+    , config_hash_(ResolveResultCache::config_hash(config_))
+    , compiled_(std::move(compiled))
+    , storage_(std::move(storage)) {
+    for (FragmentNodePtr node : compiled_.nodes) {
+        if (node) ++size_;
+    }
+}
+
+CompiledFragmentSet::CompiledFragmentSet(CompiledFragmentSet&&) noexcept = default;
+CompiledFragmentSet& CompiledFragmentSet::operator=(CompiledFragmentSet&&) noexcept = default;
+CompiledFragmentSet::~CompiledFragmentSet() = default;
+
+CompiledFragmentSet CompiledFragmentSet::compile(
+    std::map<std::string, nlohmann::json> fragments,
+    JsonResolverConfig config,
+    ThreadPool* pool
+) {
+    return CompiledFragmentSet(std::move(fragments), std::move(config), pool);
+}
+
+nlohmann::json CompiledFragmentSet::resolve(
+    const std::string& start_fragment,
+    ResolveStats* stats
+) const {
+    if (!config_.result_cache) {
+        return evaluate(start_fragment, stats);
+    }
+    return *resolve_shared(start_fragment, stats);
+}
+
+ResolvedFragmentPtr CompiledFragmentSet::resolve_shared(
+    const std::string& start_fragment,
+    ResolveStats* stats
+) const {
+    ResolveResultCache* cache = config_.result_cache.get();
+    if (!cache) {
+        return std::make_shared<const nlohmann::json>(evaluate(start_fragment, stats));
+    }
+
+    ResolveResultCache::Key key{generation_, start_fragment, config_hash_};
+    if (ResolvedFragmentPtr cached = cache->find(key)) {
+        return cached;
+    }
+    auto value = std::make_shared<const nlohmann::json>(evaluate(start_fragment, stats));
+    cache->store(std::move(key), value);
+    return value;
+}
+
+nlohmann::json CompiledFragmentSet::evaluate(
+    const std::string& start_fragment,
+    ResolveStats* stats
+) const {
+    FragmentId id = compiled_.symbols.find(start_fragment);
+    const FragmentNode* root = compiled_.node(id);
+    if (!root) {
+        throw FragmentNotFoundError(start_fragment);
+    }
+
+    ResolveBudget budget(config_.limits);
+    EvaluationContext context(compiled_, nullptr, nullptr, stats);
+    context.set_budget(budget);
+    EvaluationContext::ScopedComponent path_component(context, start_fragment);
+    StatsTimer timer(stats ? &stats->evaluate_time : nullptr);
+    return context.evaluate_fragment(id, *root, fragments_, config_);
+}
+
+nlohmann::json CompiledFragmentSet::resolve_at(
+    const std::string& start_fragment,
+    const nlohmann::json::json_pointer& pointer,
+    ResolveStats* stats
+) const {
+    const FragmentNode* root = compiled_.node(compiled_.symbols.find(start_fragment));
+    if (!root) {
+        throw FragmentNotFoundError(start_fragment);
+    }
+
+    PointerPath path(pointer);
+    ResolveBudget budget(config_.limits);
+    EvaluationContext context(compiled_, nullptr, nullptr, stats);
+    context.set_budget(budget);
+    EvaluationContext::ScopedComponent path_component(context, start_fragment);
+    StatsTimer timer(stats ? &stats->evaluate_time : nullptr);
+    return context.evaluate_fragment_at(*root, path, 0, fragments_, config_);
+}
+
+void CompiledFragmentSet::resolve_to(
+    const std::string& start_fragment,
+    std::ostream& out,
+    ResolveStats* stats
+) const {
+    const FragmentNode* root = compiled_.node(compiled_.symbols.find(start_fragment));
+    if (!root) {
+        throw FragmentNotFoundError(start_fragment);
+    }
+
+    ResolveBudget budget(config_.limits);
+    EvaluationContext context(compiled_, nullptr, nullptr, stats);
+    context.set_budget(budget);
+    EvaluationContext::ScopedComponent path_component(context, start_fragment);
+    StatsTimer timer(stats ? &stats->evaluate_time : nullptr);
+    JsonWriter writer(out);
+    root->write(fragments_, config_, context, writer);
+}
+
+std::vector<nlohmann::json> CompiledFragmentSet::resolve_many(
+    const std::vector<std::string>& start_fragments,
+    ThreadPool* pool
+) const {
+    ResolveBudget budget(config_.limits);
+    return resolve_batch(compiled_, fragments_, config_, start_fragments, pool, budget);
+}
+
+bool CompiledFragmentSet::contains(const std::string& fragment_name) const {
+    return compiled_.node(compiled_.symbols.find(fragment_name)) != nullptr;
+}
+
+} // namespace json_fragments
@@ -0,0 +1,357 @@
+// Binary save and load of compiled fragment sets.
+//
+// A plan is a header, the symbol table, then the trees, each listed in
+// fragment ID order:
+//
+//   header   "JFRGPLAN", u32 version, u32 byte order mark,
+//            start delimiter, end delimiter, u32 fragment count
+//   symbol   name, u32 reference count
+//   fragment u8 has tree, [tree]
+//   tree     u8 kind, then per kind:
+//              Literal     compact JSON text
+//              String      the string's bytes, for literals that are strings
+//              Reference   u32 fragment ID
+//              Template    text, u32 segment count,
+//                          per segment u32 offset, u32 length, u32 fragment ID
+//              Object      u32 entry count, per entry key tree, value tree
+//              Array       u32 element count, element trees
+//
+// Strings are a u32 length followed by that many bytes. Integers use the
+// byte order of the machine that wrote the plan.
+
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/exceptions.hpp"
+#include "json_fragments/fragment_implementations.hpp"
+#include "json_fragments/bytecode_evaluator.hpp"
+#include "json_fragments/dependency_tracker.hpp"
+#include "file_view.hpp"
+
+namespace json_fragments {
+
+namespace {
+
+constexpr char plan_magic[8] = {'J', 'F', 'R', 'G', 'P', 'L', 'A', 'N'};
+constexpr uint32_t plan_version = 1;
+constexpr uint32_t byte_order_mark = 0x01020304;
+
+// Containers nested deeper than this are rejected, so a hostile plan cannot
+// overflow the stack of the recursive reader
+constexpr size_t max_tree_depth = 4096;
+
+enum class NodeKind : uint8_t {
+    Literal,
+    String,
+    Reference,
+    Template,
+    Object,
+    Array
+};
+
+// Writes fragment trees in plan form by visiting them in evaluation order
+class PlanWriter : public FragmentVisitor {
+    std::ostream& out_;
+
+public:
+    explicit PlanWriter(std::ostream& out) : out_(out) {}
+
+    void u8(uint8_t value) { out_.put(static_cast<char>(value)); }
+
+    void u32(uint32_t value) { out_.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+
+    void string(std::string_view text) {
+        u32(length(text.size()));
+        out_.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+    void visit(LiteralNode& node) override {
+        // Strings, including every literal key, are stored unescaped so
+        // loading them needs no JSON parse
+        if (node.value().is_string()) {
+            u8(static_cast<uint8_t>(NodeKind::String));
+            string(node.value().get_ref<const std::string&>());
+            return;
+        }
+        u8(static_cast<uint8_t>(NodeKind::Literal));
+        if (node.serialized().empty()) {
+            string(node.value().dump());
+        } else {
+            string(node.serialized());
+        }
+    }
+
+    void visit(ReferenceNode& node) override {
+        u8(static_cast<uint8_t>(NodeKind::Reference));
+        u32(node.fragment_id());
+    }
+
+    void visit(StringTemplateNode& node) override {
+        u8(static_cast<uint8_t>(NodeKind::Template));
+        std::string_view text = node.template_text();
+        string(text);
+        auto segments = node.segments();
+        u32(length(segments.size()));
+        for (const auto& segment : segments) {
+            // Segment literals are views into the template text
+            u32(length(static_cast<size_t>(segment.literal.data() - text.data())));
+            u32(length(segment.literal.size()));
+            u32(segment.fragment);
+        }
+    }
+
+    void visit(ObjectNode& node) override {
+        u8(static_cast<uint8_t>(NodeKind::Object));
+        auto entries = node.entries();
+        u32(length(entries.size()));
+        for (const auto& [key, value] : entries) {
+            key->accept(*this);
+            value->accept(*this);
+        }
+    }
+
+    void visit(ArrayNode& node) override {
+        u8(static_cast<uint8_t>(NodeKind::Array));
+        auto elements = node.elements();
+        u32(length(elements.size()));
+        for (FragmentNodePtr element : elements) {
+            element->accept(*this);
+        }
+    }
+
+private:
+    static uint32_t length(size_t size) {
+        if (size > std::numeric_limits<uint32_t>::max()) {
+            throw PlanFormatError("value too large for the plan format");
+        }
+        return static_cast<uint32_t>(size);
+    }
+};
+
+// Rebuilds fragment trees from a mapped plan. Every read is bounds-checked,
+// and every ID is checked against the fragment count, so a damaged plan
+// fails to load instead of producing trees that point nowhere.
+class PlanReader {
+    const char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    CompiledFragments& compiled_;
+    DependencyTracker dependencies_;  // Every reference read, by the fragment it is in
+    FragmentId current_ = SymbolTable::npos;
+
+public:
+    PlanReader(const char* data, size_t size, CompiledFragments& compiled)
+        : data_(data)
+        , size_(size)
+        , compiled_(compiled)
+        , dependencies_(compiled.symbols) {}
+
+    std::string_view bytes(size_t count) {
+        if (count > size_ - pos_) fail("unexpected end of data");
+        std::string_view result(data_ + pos_, count);
+        pos_ += count;
+        return result;
+    }
+
+    uint8_t u8() { return static_cast<uint8_t>(bytes(1)[0]); }
+
+    uint32_t u32() {
+        uint32_t value;
+        std::memcpy(&value, bytes(sizeof(value)).data(), sizeof(value));
+        return value;
+    }
+
+    std::string_view string() { return bytes(u32()); }
+
+    // Reads a count of items that each take at least item_size bytes, so a
+    // corrupt count cannot make the loader allocate more than the plan holds
+    uint32_t count(size_t item_size) {
+        uint32_t count = u32();
+        if (count > (size_ - pos_) / item_size) fail("count exceeds the remaining data");
+        return count;
+    }
+
+    bool at_end() const { return pos_ == size_; }
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw PlanFormatError(what + " at byte " + std::to_string(pos_));
+    }
+
+    // Reads the tree of one fragment, recording the fragments it refers to
+    FragmentNodePtr fragment_tree(FragmentId fragment, size_t fragment_count) {
+        current_ = fragment;
+        return tree(fragment_count, 0);
+    }
+
+    // A plan written by save() is acyclic, since compile() rejects cycles;
+    // one with a cycle would recurse without end when resolved
+    void check_for_cycles() const {
+        try {
+            dependencies_.check_for_cycles();
+        } catch (const CircularDependencyError& e) {
+            throw PlanFormatError(e.what());
+        }
+    }
+
+    FragmentNodePtr tree(size_t fragment_count, size_t depth) {
+        if (depth > max_tree_depth) {
+            fail("containers nested deeper than " + std::to_string(max_tree_depth));
+        }
+        NodeArena& arena = compiled_.arena;
+        switch (static_cast<NodeKind>(u8())) {
+            case NodeKind::Literal: {
+                std::string_view text = string();
+                nlohmann::json* value;
+                try {
+                    value = arena.create<nlohmann::json>(
+                        nlohmann::json::parse(text.begin(), text.end()));
+                } catch (const nlohmann::json::exception& e) {
+                    fail(std::string("invalid literal: ") + e.what());
+                }
+                // Streaming copies non-empty containers verbatim, as after compile()
+                bool verbatim = value->is_structured() && !value->empty();
+                return arena.create<LiteralNode>(*value, verbatim ? text : std::string_view());
+            }
+
+            case NodeKind::String: {
+                std::string_view text = string();
+                return arena.create<LiteralNode>(*arena.create<nlohmann::json>(text));
+            }
+
+            case NodeKind::Reference: {
+                FragmentId fragment = fragment_id(fragment_count);
+                return arena.create<ReferenceNode>(fragment, compiled_.symbols.name(fragment));
+            }
+
+            case NodeKind::Template: {
+                std::string_view text = string();
+                auto segments = arena.make_array<StringTemplateNode::Segment>(count(12));
+                if (segments.empty()) fail("template without segments");
+                for (size_t i = 0; i < segments.size(); ++i) {
+                    uint32_t offset = u32();
+                    uint32_t length = u32();
+                    if (offset > text.size() || length > text.size() - offset) {
+                        fail("template segment outside its text");
+                    }
+                    segments[i].literal = text.substr(offset, length);
+                    if (i + 1 < segments.size()) {
+                        segments[i].fragment = fragment_id(fragment_count);
+                        segments[i].fragment_name = &compiled_.symbols.name(segments[i].fragment);
+                    } else if (u32() != SymbolTable::npos) {
+                        fail("template ends with a reference");
+                    }
+                }
+                return arena.create<StringTemplateNode>(text, segments);
+            }
+
+            case NodeKind::Object: {
+                auto entries = arena.make_array<ObjectNode::Entry>(count(2));
+                for (auto& entry : entries) {
+                    entry.first = tree(fragment_count, depth + 1);
+                    entry.second = tree(fragment_count, depth + 1);
+                }
+                return arena.create<ObjectNode>(entries, arena);
+            }
+
+            case NodeKind::Array: {
+                auto elements = arena.make_array<FragmentNodePtr>(count(1));
+                for (auto& element : elements) {
+                    element = tree(fragment_count, depth + 1);
+                }
+                return arena.create<ArrayNode>(elements);
+            }
+        }
+        fail("unknown node kind");
+    }
+
+private:
+    FragmentId fragment_id(size_t fragment_count) {
+        FragmentId fragment = u32();
+        if (fragment >= fragment_count) fail("reference to an unknown fragment");
+        dependencies_.add_dependency(current_, fragment);
+        return fragment;
+    }
+};
+
+} // namespace
+
+void CompiledFragmentSet::save(std::ostream& out) const {
+    PlanWriter writer(out);
+    out.write(plan_magic, sizeof(plan_magic));
+    writer.u32(plan_version);
+    writer.u32(byte_order_mark);
+    writer.string(config_.delimiters.start);
+    writer.string(config_.delimiters.end);
+
+    writer.u32(static_cast<uint32_t>(compiled_.symbols.size()));
+    for (FragmentId fragment = 0; fragment < compiled_.symbols.size(); ++fragment) {
+        writer.string(compiled_.symbols.name(fragment));
+        writer.u32(compiled_.reference_counts[fragment]);
+    }
+    for (FragmentId fragment = 0; fragment < compiled_.symbols.size(); ++fragment) {
+        FragmentNodePtr node = compiled_.nodes[fragment];
+        writer.u8(node != nullptr);
+        if (node) node->accept(writer);
+    }
+}
+
+CompiledFragmentSet CompiledFragmentSet::load(const std::string& path, JsonResolverConfig config) {
+    std::shared_ptr<const FileView> file;
+    try {
+        file = std::make_shared<const FileView>(path);
+    } catch (const FileError& e) {
+        throw PlanFormatError(e.message);
+    }
+
+    CompiledFragments compiled;
+    PlanReader reader(file->data(), file->size(), compiled);
+    if (reader.bytes(sizeof(plan_magic)) != std::string_view(plan_magic, sizeof(plan_magic))) {
+        throw PlanFormatError("'" + path + "' is not a compiled plan");
+    }
+    if (reader.u32() != plan_version) {
+        throw PlanFormatError("'" + path + "' was written by an unsupported version");
+    }
+    if (reader.u32() != byte_order_mark) {
+        throw PlanFormatError("'" + path + "' was written with a different byte order");
+    }
+    std::string_view start = reader.string();
+    std::string_view end = reader.string();
+    if (start != config.delimiters.start || end != config.delimiters.end) {
+        throw PlanFormatError("'" + path + "' was compiled with delimiters " +
+                              std::string(start) + std::string(end));
+    }
+
+    // Every name is interned before any tree, since trees refer to later IDs
+    uint32_t count = reader.count(8);
+    for (uint32_t fragment = 0; fragment < count; ++fragment) {
+        if (compiled.add(reader.string(), nullptr) != fragment) {
+            reader.fail("duplicate fragment name");
+        }
+        compiled.reference_counts[fragment] = reader.u32();
+    }
+    for (uint32_t fragment = 0; fragment < count; ++fragment) {
+        if (reader.u8()) {
+            compiled.nodes[fragment] = reader.fragment_tree(fragment, count);
+        }
+    }
+    if (!reader.at_end()) {
+        reader.fail("unexpected data after the last fragment");
+    }
+    reader.check_for_cycles();
+
+    if (config.engine == JsonResolverConfig::EvaluationEngine::Bytecode) {
+        for (FragmentNodePtr& node : compiled.nodes) {
+            if (node && !node->constant_value()) {
+                node = BytecodeCompiler::compile(node, compiled.arena);
+            }
+        }
+    }
+
+    return CompiledFragmentSet(std::move(config), std::move(compiled), std::move(file));
+}
+
+} // namespace json_fragments
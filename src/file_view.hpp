@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace json_fragments {
+
+// Why a file could not be opened; callers report it as their own error type
+struct FileError {
+    std::string message;
+};
+
+// Read-only view of a whole file. Mapped where the platform supports it,
+// otherwise read into memory.
+class FileView {
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#if defined(_WIN32)
+    std::string buffer_;
+#endif
+
+public:
+    explicit FileView(const std::string& path) {
+#if defined(_WIN32)
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw FileError{"Cannot open '" + path + "'"};
+        }
+        buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw FileError{"Cannot open '" + path + "': " + std::strerror(errno)};
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw FileError{"Cannot read '" + path + "': " + std::strerror(error)};
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ > 0) {
+            void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                int error = errno;
+                ::close(fd);
+                throw FileError{"Cannot map '" + path + "': " + std::strerror(error)};
+            }
+            data_ = static_cast<const char*>(mapping);
+        }
+        // The mapping stays valid after the descriptor is closed
+        ::close(fd);
+#endif
+    }
+
+    ~FileView() {
+#if !defined(_WIN32)
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+};
+
+} // namespace json_fragments
@@ -0,0 +1,227 @@
+#include "json_fragments/fragment_graph.hpp"
+#include "json_fragments/fragment_implementations.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace json_fragments {
+
+namespace {
+
+// Lists every fragment a tree refers to, in the order they appear
+class ReferenceCollector : public FragmentVisitor {
+    std::vector<FragmentId>& found_;
+
+public:
+    explicit ReferenceCollector(std::vector<FragmentId>& found) : found_(found) {}
+
+    void visit(LiteralNode&) override {}
+
+    void visit(ReferenceNode& node) override {
+        found_.push_back(node.fragment_id());
+    }
+
+    void visit(StringTemplateNode& node) override {
+        for (const auto& segment : node.segments()) {
+            if (segment.fragment != SymbolTable::npos) found_.push_back(segment.fragment);
+        }
+    }
+
+    void visit(ObjectNode& node) override {
+        for (const auto& [key, value] : node.entries()) {
+            key->accept(*this);
+            value->accept(*this);
+        }
+    }
+
+    void visit(ArrayNode& node) override {
+        for (FragmentNodePtr element : node.elements()) {
+            element->accept(*this);
+        }
+    }
+};
+
+std::string dot_string(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '\n') {
+            quoted += "\\n";
+            continue;
+        }
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+std::string milliseconds(std::chrono::nanoseconds time) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f ms", time.count() / 1e6);
+    return buffer;
+}
+
+} // namespace
+
+FragmentGraph::FragmentGraph(const CompiledFragments& compiled)
+    : exists_(compiled.symbols.size(), false)
+    , edges_(compiled.symbols.size()) {
+    names_.reserve(compiled.symbols.size());
+    for (FragmentId id = 0; id < compiled.symbols.size(); ++id) {
+        names_.push_back(compiled.symbols.name(id));
+
+        FragmentNodePtr node = id < compiled.nodes.size() ? compiled.nodes[id] : nullptr;
+        if (!node) continue;
+        exists_[id] = true;
+
+        auto& edges = edges_[id];
+        ReferenceCollector collector(edges);
+        node->accept(collector);
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    }
+}
+
+std::map<std::string, std::set<std::string>> FragmentGraph::dependencies() const {
+    std::map<std::string, std::set<std::string>> dependencies;
+    for (FragmentId from = 0; from < edges_.size(); ++from) {
+        if (edges_[from].empty()) continue;
+        auto& targets = dependencies[names_[from]];
+        for (FragmentId to : edges_[from]) {
+            targets.insert(names_[to]);
+        }
+    }
+    return dependencies;
+}
+
+std::vector<std::vector<std::string>> FragmentGraph::longest_chains(size_t count) const {
+    const size_t n = names_.size();
+
+    // length[f] counts the fragments on the longest chain from f, and
+    // next[f] is the dependency that chain continues with. Iterative, so
+    // deep chains cannot overflow the stack; a compiled set is acyclic,
+    // but an edge back into the walk is skipped rather than followed.
+    enum : uint8_t { Unvisited, Walking, Done };
+    std::vector<size_t> length(n, 0);
+    std::vector<FragmentId> next(n, SymbolTable::npos);
+    std::vector<uint8_t> state(n, Unvisited);
+    std::vector<std::pair<FragmentId, size_t>> stack;
+
+    for (FragmentId root = 0; root < n; ++root) {
+        if (state[root] != Unvisited) continue;
+        state[root] = Walking;
+        stack.push_back({root, 0});
+
+        while (!stack.empty()) {
+            FragmentId node = stack.back().first;
+            size_t edge = stack.back().second++;
+            if (edge < edges_[node].size()) {
+                FragmentId dependency = edges_[node][edge];
+                if (state[dependency] == Unvisited) {
+                    state[dependency] = Walking;
+                    stack.push_back({dependency, 0});
+                }
+                continue;
+            }
+
+            length[node] = 1;
+            for (FragmentId dependency : edges_[node]) {
+                if (state[dependency] == Done && length[dependency] + 1 > length[node]) {
+                    length[node] = length[dependency] + 1;
+                    next[node] = dependency;
+                }
+            }
+            state[node] = Done;
+            stack.pop_back();
+        }
+    }
+
+    std::vector<bool> referenced(n, false);
+    for (const auto& edges : edges_) {
+        for (FragmentId to : edges) referenced[to] = true;
+    }
+    std::vector<FragmentId> roots;
+    for (FragmentId id = 0; id < n; ++id) {
+        if (!referenced[id]) roots.push_back(id);
+    }
+    count = std::min(count, roots.size());
+    std::partial_sort(roots.begin(), roots.begin() + count, roots.end(),
+        [&](FragmentId a, FragmentId b) {
+            if (length[a] != length[b]) return length[a] > length[b];
+            return names_[a] < names_[b];
+        });
+
+    std::vector<std::vector<std::string>> chains(count);
+    for (size_t i = 0; i < count; ++i) {
+        for (FragmentId id = roots[i]; id != SymbolTable::npos; id = next[id]) {
+            chains[i].push_back(names_[id]);
+        }
+    }
+    return chains;
+}
+
+void FragmentGraph::write_dot(std::ostream& out, const ResolveStats* profile) const {
+    std::set<std::string> hottest;
+    if (profile) {
+        for (auto& name : profile->hottest(10)) hottest.insert(std::move(name));
+    }
+
+    out << "digraph fragments {\n";
+    for (FragmentId id = 0; id < names_.size(); ++id) {
+        std::string label = names_[id];
+        if (profile) {
+            auto it = profile->fragments.find(names_[id]);
+            if (it != profile->fragments.end()) {
+                const auto& figures = it->second;
+                label += "\n" + std::to_string(figures.evaluations) + " evaluations, " +
+                         milliseconds(figures.time);
+                if (profile->measure_output) {
+                    label += ", " + std::to_string(figures.output_bytes) + " B";
+                }
+            }
+        }
+
+        // Graphviz keeps only the last style given, so both go in one
+        bool missing = !exists_[id];
+        bool hot = hottest.count(names_[id]) > 0;
+        out << "  " << dot_string(names_[id]) << " [label=" << dot_string(label);
+        if (missing && hot) out << ", style=\"dashed,filled\"";
+        else if (missing) out << ", style=dashed";
+        else if (hot) out << ", style=filled";
+        if (hot) out << ", fillcolor=\"#f4a582\"";
+        out << "];\n";
+    }
+    for (FragmentId from = 0; from < edges_.size(); ++from) {
+        for (FragmentId to : edges_[from]) {
+            out << "  " << dot_string(names_[from]) << " -> " << dot_string(names_[to]) << ";\n";
+        }
+    }
+    out << "}\n";
+}
+
+nlohmann::json FragmentGraph::to_json(const ResolveStats* profile, size_t report_count) const {
+    nlohmann::json fragments = nlohmann::json::object();
+    for (FragmentId id = 0; id < names_.size(); ++id) {
+        nlohmann::json dependencies = nlohmann::json::array();
+        for (FragmentId to : edges_[id]) dependencies.push_back(names_[to]);
+
+        nlohmann::json& fragment = fragments[names_[id]];
+        fragment["dependencies"] = std::move(dependencies);
+        if (!exists_[id]) fragment["missing"] = true;
+
+        if (!profile) continue;
+        auto it = profile->fragments.find(names_[id]);
+        if (it == profile->fragments.end()) continue;
+        fragment["evaluations"] = it->second.evaluations;
+        fragment["time_ns"] = it->second.time.count();
+        if (profile->measure_output) fragment["output_bytes"] = it->second.output_bytes;
+    }
+
+    nlohmann::json result = {
+        {"fragments", std::move(fragments)},
+        {"longest_chains", longest_chains(report_count)}
+    };
+    if (profile) result["hottest"] = profile->hottest(report_count);
+    return result;
+}
+
+} // namespace json_fragments
@@ -0,0 +1,562 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "json_fragments/fragment_nodes.hpp"
+#include "json_fragments/fragment_source.hpp"
+#include "json_fragments/fragment_implementations.hpp"
+#include "json_fragments/bytecode_evaluator.hpp"
+#include "json_fragments/delimiter_scanner.hpp"
+#include "json_fragments/dependency_tracker.hpp"
+#include "json_fragments/exceptions.hpp"
+#include "json_fragments/static_delimiters.hpp"
+
+namespace json_fragments {
+
+// Parses fragments into node trees. Delimiters is ConfiguredDelimiters to
+// read the delimiters from the configuration, or a compile-time set such as
+// BracketDelimiters, which must match the configuration's.
+template <typename Delimiters = ConfiguredDelimiters>
+class BasicFragmentParser {
+private:
+    static constexpr bool configured = std::is_same_v<Delimiters, ConfiguredDelimiters>;
+
+    const JsonResolverConfig& config_;
+    std::optional<MapFragmentSource> owned_source_;
+    const FragmentSource& source_;
+    CompiledFragments compiled_;
+    DependencyTracker dependency_tracker_;
+    bool serialize_literals_;
+    ResolveStats* stats_ = nullptr;
+    ResolveBudget* budget_ = nullptr;
+
+    // Trees replaced by recompile_fragment() since the arena was last
+    // rebuilt; their nodes stay in the arena until then
+    size_t retired_trees_ = 0;
+
+    // Set in the workers of a parallel compile_all(). Names are looked up in
+    // the main parser's symbol table, which no worker modifies, and the
+    // references of the fragment being parsed are collected for the main
+    // parser to record.
+    const CompiledFragments* shared_ = nullptr;
+    std::vector<FragmentId> pending_references_;
+
+    // Thrown by a worker that meets a name it cannot intern
+    struct NameNotShared {};
+
+    // Helper class for RAII-style fragment evaluation
+    class FragmentEvaluationGuard {
+    private:
+        DependencyTracker& tracker_;
+        FragmentId fragment_;
+
+    public:
+        FragmentEvaluationGuard(DependencyTracker& tracker, FragmentId fragment)
+            : tracker_(tracker)
+            , fragment_(fragment) {
+            tracker_.begin_evaluation(fragment_);
+        }
+
+        ~FragmentEvaluationGuard() {
+            tracker_.end_evaluation(fragment_);
+        }
+    };
+
+    std::string_view start_delimiter() const {
+        if constexpr (configured) {
+            return config_.delimiters.start;
+        } else {
+            return Delimiters::start;
+        }
+    }
+
+    std::string_view end_delimiter() const {
+        if constexpr (configured) {
+            return config_.delimiters.end;
+        } else {
+            return Delimiters::end;
+        }
+    }
+
+    // Searches for a delimiter, by character when it is known at compile
+    // time to be a single one
+    static size_t find_delimiter(std::string_view text, std::string_view delimiter, size_t pos = 0) {
+        if constexpr (!configured) {
+            if (delimiter.size() == 1) return text.find(delimiter.front(), pos);
+        }
+        return DelimiterScanner::find(text, delimiter, pos);
+    }
+
+    static size_t rfind_delimiter(std::string_view text, std::string_view delimiter, size_t pos) {
+        if constexpr (!configured) {
+            if (delimiter.size() == 1) return text.rfind(delimiter.front(), pos);
+        }
+        return text.rfind(delimiter, pos);
+    }
+
+    bool contains_start(std::string_view text) const {
+        return find_delimiter(text, start_delimiter()) != std::string_view::npos;
+    }
+
+    // Helper to extract the fragment name from a reference
+    std::string_view extract_fragment_name(std::string_view reference) const {
+        return reference.substr(
+            start_delimiter().length(),
+            reference.length() - start_delimiter().length() - end_delimiter().length()
+        );
+    }
+
+    // Helper method to check if a string is a complete fragment reference.
+    // Strings like "[a] and [b]" start and end with delimiters too, but are
+    // templates: the name of a complete reference contains no delimiters.
+    bool is_complete_fragment_reference(std::string_view str) const {
+        const std::string_view start = start_delimiter();
+        const std::string_view end = end_delimiter();
+        if (str.length() < start.length() + end.length() ||
+            str.compare(0, start.length(), start) != 0 ||
+            str.compare(str.length() - end.length(), end.length(), end) != 0) {
+            return false;
+        }
+
+        std::string_view name = extract_fragment_name(str);
+        return find_delimiter(name, start) == std::string_view::npos &&
+               find_delimiter(name, end) == std::string_view::npos;
+    }
+
+    // Splits a string template into literal text and references, pairing
+    // each innermost [name] with the text before it
+    std::vector<std::pair<std::string_view, std::string_view>>
+    tokenize_template(std::string_view text) const {
+        std::vector<std::pair<std::string_view, std::string_view>> tokens;
+        size_t pos = 0;
+        size_t literal_start = 0;
+        while (pos < text.length()) {
+            size_t end_pos = find_delimiter(text, end_delimiter(), pos);
+            if (end_pos == std::string_view::npos) break;
+
+            size_t start_pos = rfind_delimiter(text, start_delimiter(), end_pos);
+            if (start_pos != std::string_view::npos && start_pos >= pos) {
+                size_t name_start = start_pos + start_delimiter().length();
+                tokens.emplace_back(
+                    text.substr(literal_start, start_pos - literal_start),
+                    text.substr(name_start, end_pos - name_start)
+                );
+                literal_start = end_pos + end_delimiter().length();
+            }
+            pos = end_pos + end_delimiter().length();
+        }
+        tokens.emplace_back(text.substr(literal_start), std::string_view());
+        return tokens;
+    }
+
+    const SymbolTable& symbols() const {
+        return shared_ ? shared_->symbols : compiled_.symbols;
+    }
+
+    // Interns a fragment name, looking up its raw value the first time
+    FragmentId intern(std::string_view fragment_name) {
+        if (shared_) {
+            FragmentId fragment = shared_->symbols.find(fragment_name);
+            if (fragment == SymbolTable::npos) throw NameNotShared{};
+            return fragment;
+        }
+
+        FragmentId fragment = compiled_.symbols.find(fragment_name);
+        if (fragment != SymbolTable::npos) {
+            return fragment;
+        }
+
+        return compiled_.add(fragment_name, source_.find(fragment_name));
+    }
+
+    // Records a dependency of the current fragment and parses the dependency
+    FragmentId add_reference(FragmentId current_fragment, std::string_view fragment_name) {
+        FragmentId fragment = intern(fragment_name);
+        if (shared_) {
+            pending_references_.push_back(fragment);
+            return fragment;
+        }
+        ++compiled_.reference_counts[fragment];
+        if (current_fragment != SymbolTable::npos) {
+            dependency_tracker_.add_dependency(current_fragment, fragment);
+            compile_fragment(fragment);
+        }
+        return fragment;
+    }
+
+    // Creates a node in the arena, counting it by type
+    template <typename Node, typename... Args>
+    Node* create(Args&&... args) {
+        if (budget_) budget_->add_nodes(1);
+        if (stats_) {
+            if constexpr (std::is_same_v<Node, LiteralNode>) ++stats_->literal_nodes;
+            if constexpr (std::is_same_v<Node, ReferenceNode>) ++stats_->reference_nodes;
+            if constexpr (std::is_same_v<Node, StringTemplateNode>) ++stats_->template_nodes;
+            if constexpr (std::is_same_v<Node, ObjectNode>) ++stats_->object_nodes;
+            if constexpr (std::is_same_v<Node, ArrayNode>) ++stats_->array_nodes;
+        }
+        return compiled_.arena.create<Node>(std::forward<Args>(args)...);
+    }
+
+    std::string_view copy_string(std::string_view text) {
+        if (stats_) stats_->bytes_copied += text.size();
+        return compiled_.arena.copy_string(text);
+    }
+
+    // Creates a node referring to an interned fragment
+    FragmentNodePtr make_reference(FragmentId fragment) {
+        return create<ReferenceNode>(fragment, symbols().name(fragment));
+    }
+
+    // Re-parses every live tree into a fresh arena, releasing the nodes of
+    // replaced trees. IDs and dependencies are unchanged.
+    void rebuild_arena() {
+        compiled_.arena = NodeArena();
+        std::fill(compiled_.nodes.begin(), compiled_.nodes.end(), nullptr);
+        std::fill(compiled_.reference_counts.begin(), compiled_.reference_counts.end(), 0);
+        for (FragmentId fragment = 0; fragment < compiled_.sources.size(); ++fragment) {
+            compile_fragment(fragment);
+        }
+        retired_trees_ = 0;
+    }
+
+public:
+    // With serialize_literals, reference-free objects and arrays also keep
+    // their serialized text, so streaming output can copy it verbatim
+    BasicFragmentParser(
+        const JsonResolverConfig& config,
+        const std::map<std::string, nlohmann::json>& fragments,
+        bool serialize_literals = false
+    )
+        : config_(config)
+        , owned_source_(std::in_place, fragments)
+        , source_(*owned_source_)
+        , dependency_tracker_(compiled_.symbols)
+        , serialize_literals_(serialize_literals) {}
+
+    // Looks fragments up in a source, which must outlive the parser and
+    // every tree it produces
+    BasicFragmentParser(
+        const JsonResolverConfig& config,
+        const FragmentSource& source,
+        bool serialize_literals = false
+    )
+        : config_(config)
+        , source_(source)
+        , dependency_tracker_(compiled_.symbols)
+        , serialize_literals_(serialize_literals) {}
+
+    BasicFragmentParser(const BasicFragmentParser&) = delete;
+    BasicFragmentParser& operator=(const BasicFragmentParser&) = delete;
+
+    // Counts parsing work in stats from now on, or stops counting if null
+    void collect_stats(ResolveStats* stats) { stats_ = stats; }
+
+    // Checks parsing against a budget from now on, if it has any limits
+    void set_budget(ResolveBudget& budget) { budget_ = budget.active() ? &budget : nullptr; }
+
+    // Parses a fragment and everything it depends on. Each fragment is
+    // parsed at most once per parser; later calls return the cached node.
+    const FragmentNode* compile_fragment(FragmentId fragment) {
+        if (const FragmentNode* node = compiled_.node(fragment)) {
+            return node;
+        }
+
+        const nlohmann::json* source = compiled_.sources[fragment];
+        if (!source) {
+            return nullptr;  // Fragment not found, skip evaluation
+        }
+
+        if (stats_) ++stats_->cycle_check_visits;
+        if (budget_) {
+            budget_->check_deadline();
+            budget_->check_depth(dependency_tracker_.evaluation_depth() + 1);
+        }
+        FragmentEvaluationGuard guard(dependency_tracker_, fragment);
+        FragmentNodePtr node = build(*source, fragment);
+        compiled_.nodes[fragment] = node;
+        return node;
+    }
+
+    // Parses one fragment's tree, and compiles it for the bytecode engine
+    // if that is configured
+    FragmentNodePtr build(const nlohmann::json& source, FragmentId fragment) {
+        FragmentNodePtr node = parse(source, fragment);
+        if (config_.engine == JsonResolverConfig::EvaluationEngine::Bytecode &&
+            !node->constant_value()) {
+            node = BytecodeCompiler::compile(node, compiled_.arena);
+        }
+        return node;
+    }
+
+    const FragmentNode* compile_fragment(const std::string& fragment_name) {
+        return compile_fragment(intern(fragment_name));
+    }
+
+    // Parses every fragment in the set. With a pool, fragments are parsed
+    // independently on its threads and the cycle check runs once over the
+    // merged graph afterwards; the trees are the same either way.
+    void compile_all(ThreadPool* pool = nullptr) {
+        if (pool && pool->size() > 0) {
+            compile_all_parallel(*pool);
+            return;
+        }
+        source_.for_each_name([this](const std::string& name) {
+            compile_fragment(intern(name));
+        });
+    }
+
+private:
+    // What one chunk of a parallel compile produced
+    struct ParallelChunk {
+        std::unique_ptr<BasicFragmentParser> parser;  // Owns the chunk's arena
+        ResolveStats stats;  // Merged into the main parser's afterwards
+        std::vector<std::pair<FragmentId, FragmentNodePtr>> nodes;
+        std::vector<std::pair<FragmentId, FragmentId>> references;  // One per occurrence
+        std::vector<FragmentId> deferred;
+    };
+
+    void compile_all_parallel(ThreadPool& pool) {
+        // Every name is interned before any worker starts, so workers only
+        // read the symbol table. Raw values are looked up by the workers, so
+        // a lazy source parses them in parallel too.
+        std::vector<FragmentId> fragments;
+        source_.for_each_name([&](const std::string& name) {
+            FragmentId fragment = compiled_.add(name, nullptr);
+            if (!compiled_.nodes[fragment]) fragments.push_back(fragment);
+        });
+
+        const size_t chunk_count = std::min(fragments.size(), (pool.size() + 1) * 4);
+        std::vector<ParallelChunk> chunks(chunk_count);
+        pool.parallel_for(chunk_count, [&](size_t index) {
+            ParallelChunk& chunk = chunks[index];
+            chunk.parser = std::make_unique<BasicFragmentParser>(config_, source_, serialize_literals_);
+            chunk.parser->shared_ = &compiled_;
+            // The budget's counters are atomic, so every chunk shares it
+            chunk.parser->budget_ = budget_;
+            if (stats_) chunk.parser->stats_ = &chunk.stats;
+
+            const size_t begin = fragments.size() * index / chunk_count;
+            const size_t end = fragments.size() * (index + 1) / chunk_count;
+            for (size_t i = begin; i < end; ++i) {
+                FragmentId fragment = fragments[i];
+                const nlohmann::json* source = source_.find(compiled_.symbols.name(fragment));
+                compiled_.sources[fragment] = source;
+                if (!source) continue;
+                if (budget_) budget_->check_deadline();
+
+                chunk.parser->pending_references_.clear();
+                FragmentNodePtr node;
+                try {
+                    node = chunk.parser->build(*source, fragment);
+                } catch (const NameNotShared&) {
+                    chunk.deferred.push_back(fragment);
+                    continue;
+                }
+                chunk.nodes.emplace_back(fragment, node);
+                for (FragmentId dependency : chunk.parser->pending_references_) {
+                    chunk.references.emplace_back(fragment, dependency);
+                }
+            }
+        });
+
+        for (ParallelChunk& chunk : chunks) {
+            if (stats_) stats_->merge(chunk.stats);
+            compiled_.arena.adopt(std::move(chunk.parser->compiled_.arena));
+            for (auto [fragment, node] : chunk.nodes) {
+                compiled_.nodes[fragment] = node;
+            }
+            for (auto [dependent, dependency] : chunk.references) {
+                ++compiled_.reference_counts[dependency];
+                dependency_tracker_.add_dependency(dependent, dependency);
+            }
+        }
+
+        // Fragments that refer to names outside the set, which only the main
+        // parser may intern, are parsed here; everything they refer to that
+        // was in the set is already parsed
+        for (ParallelChunk& chunk : chunks) {
+            for (FragmentId fragment : chunk.deferred) {
+                compile_fragment(fragment);
+            }
+        }
+        dependency_tracker_.check_for_cycles();
+    }
+
+public:
+    // Re-parses one fragment after its raw value changed, replacing its tree
+    // and its recorded dependencies. A null source removes the fragment. If
+    // the new value would close a cycle, CircularDependencyError is thrown
+    // and the previous tree and dependencies are kept. The arena is rebuilt
+    // once more trees have been replaced than there are fragments, which
+    // bounds the memory held by replaced trees at amortized constant cost.
+    FragmentId recompile_fragment(std::string_view fragment_name, const nlohmann::json* source) {
+        FragmentId fragment = intern(fragment_name);
+        const nlohmann::json* old_source = compiled_.sources[fragment];
+        FragmentNodePtr old_node = std::exchange(compiled_.nodes[fragment], nullptr);
+        std::vector<FragmentId> old_dependencies = dependency_tracker_.dependencies_of(fragment);
+
+        compiled_.sources[fragment] = source;
+        dependency_tracker_.clear_dependencies(fragment);
+        try {
+            compile_fragment(fragment);
+            dependency_tracker_.check_for_cycles_through(fragment);
+        } catch (...) {
+            compiled_.sources[fragment] = old_source;
+            compiled_.nodes[fragment] = old_node;
+            dependency_tracker_.clear_dependencies(fragment);
+            for (FragmentId dependency : old_dependencies) {
+                dependency_tracker_.add_dependency(fragment, dependency);
+            }
+            throw;
+        }
+
+        if (++retired_trees_ > compiled_.nodes.size()) {
+            rebuild_arena();
+        }
+        return fragment;
+    }
+
+    // Supplies the value of a fragment that had none when it was first
+    // referenced, as when an asynchronous fetch delivers it, and parses it.
+    // Cycles closed by a late value are not seen while parsing, so call
+    // check_for_cycles() once every value has arrived.
+    const FragmentNode* provide_fragment(std::string_view fragment_name, const nlohmann::json* source) {
+        FragmentId fragment = intern(fragment_name);
+        if (!compiled_.sources[fragment]) compiled_.sources[fragment] = source;
+        return compile_fragment(fragment);
+    }
+
+    void check_for_cycles() const {
+        dependency_tracker_.check_for_cycles();
+    }
+
+    // Main entry point - converts JSON value into appropriate node type.
+    // Subtrees without references become a single literal node pointing at
+    // the input, so the input must outlive the nodes.
+    FragmentNodePtr parse(const nlohmann::json& input, FragmentId current_fragment = SymbolTable::npos) {
+        if (FragmentNodePtr node = parse_references(input, current_fragment)) return node;
+        return make_literal(input);
+    }
+
+private:
+    // Parses a value bottom-up in one pass, returning nullptr when it
+    // contains nothing that could be a reference: no key or string with the
+    // start delimiter. A container whose children all come back nullptr is
+    // constant too, so no subtree is scanned twice and no nodes are built
+    // for a constant one.
+    FragmentNodePtr parse_references(const nlohmann::json& input, FragmentId current_fragment) {
+        if (input.is_string()) {
+            const std::string& str = input.get_ref<const std::string&>();
+            if (is_complete_fragment_reference(str)) {
+                return make_reference(add_reference(current_fragment, extract_fragment_name(str)));
+            }
+            if (!contains_start(str)) return nullptr;
+
+            // Segment literals point into the arena's copy of the text
+            std::string_view text = copy_string(str);
+            auto tokens = tokenize_template(text);
+            auto segments = compiled_.arena.make_array<StringTemplateNode::Segment>(tokens.size());
+            for (size_t i = 0; i < tokens.size(); ++i) {
+                auto& segment = segments[i];
+                segment.literal = tokens[i].first;
+                if (i + 1 < tokens.size()) {
+                    segment.fragment = add_reference(current_fragment, tokens[i].second);
+                    segment.fragment_name = &symbols().name(segment.fragment);
+                }
+            }
+            return create<StringTemplateNode>(text, segments);
+        }
+
+        if (input.is_object()) {
+            // Allocated at the first key or value with references; the
+            // entries before it are all constant
+            ArenaArray<ObjectNode::Entry> entries;
+            size_t i = 0;
+            for (auto it = input.begin(); it != input.end(); ++it, ++i) {
+                FragmentNodePtr key = nullptr;
+                if (contains_start(it.key())) key = parse_key(it.key(), current_fragment);
+                FragmentNodePtr value = parse_references(it.value(), current_fragment);
+                if (!key && !value && entries.empty()) continue;
+
+                if (entries.empty()) {
+                    entries = compiled_.arena.make_array<ObjectNode::Entry>(input.size());
+                    size_t j = 0;
+                    for (auto before = input.begin(); before != it; ++before, ++j) {
+                        entries[j].first = parse_key(before.key(), current_fragment);
+                        entries[j].second = make_literal(before.value());
+                    }
+                }
+                entries[i].first = key ? key : parse_key(it.key(), current_fragment);
+                entries[i].second = value ? value : make_literal(it.value());
+            }
+            return entries.empty() ? nullptr : create<ObjectNode>(entries, compiled_.arena);
+        }
+
+        if (input.is_array()) {
+            ArenaArray<FragmentNodePtr> elements;
+            for (size_t i = 0; i < input.size(); ++i) {
+                FragmentNodePtr element = parse_references(input[i], current_fragment);
+                if (!element && elements.empty()) continue;
+
+                if (elements.empty()) {
+                    elements = compiled_.arena.make_array<FragmentNodePtr>(input.size());
+                    for (size_t j = 0; j < i; ++j) elements[j] = make_literal(input[j]);
+                }
+                elements[i] = element ? element : make_literal(input[i]);
+            }
+            return elements.empty() ? nullptr : create<ArrayNode>(elements);
+        }
+
+        return nullptr;
+    }
+
+    // An object key: a reference when it is one whole placeholder, else the
+    // key text itself
+    FragmentNodePtr parse_key(const std::string& key, FragmentId current_fragment) {
+        if (is_complete_fragment_reference(key)) {
+            return make_reference(add_reference(current_fragment, extract_fragment_name(key)));
+        }
+        return create<LiteralNode>(*compiled_.arena.create<nlohmann::json>(key));
+    }
+
+    // A subtree without references, as one node pointing at the input
+    FragmentNodePtr make_literal(const nlohmann::json& input) {
+        std::string_view serialized;
+        if (serialize_literals_ && input.is_structured() && !input.empty()) {
+            serialized = copy_string(input.dump());
+        }
+        return create<LiteralNode>(input, serialized);
+    }
+
+public:
+    auto get_dependencies() const { return dependency_tracker_.get_dependencies(); }
+
+    const DependencyTracker& dependency_tracker() const { return dependency_tracker_; }
+
+    // All fragments parsed so far
+    const CompiledFragments& compiled() const { return compiled_; }
+
+    // Hands ownership of all parsed fragment nodes to the caller
+    CompiledFragments take_compiled() { return std::move(compiled_); }
+};
+
+using FragmentParser = BasicFragmentParser<>;
+
+// Calls body with a default-constructed delimiter set: the compile-time set
+// matching the configuration if there is one, else ConfiguredDelimiters
+template <typename Body>
+decltype(auto) with_delimiters(const JsonResolverConfig& config, Body&& body) {
+    if (uses_delimiters<BracketDelimiters>(config)) return body(BracketDelimiters{});
+    if (uses_delimiters<DoubleBraceDelimiters>(config)) return body(DoubleBraceDelimiters{});
+    return body(ConfiguredDelimiters{});
+}
+
+} // namespace json_fragments
@@ -0,0 +1,164 @@
+#include "json_fragments/incremental_resolver.hpp"
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include "json_fragments/exceptions.hpp"
+#include "json_fragments/resolve_result_cache.hpp"
+#include "fragment_parser.hpp"
+
+namespace json_fragments {
+
+struct IncrementalResolver::Impl : FragmentResultCache {
+    JsonResolverConfig config;
+    std::map<std::string, nlohmann::json> fragments;
+    FragmentParser parser;
+    uint64_t generation = 0;
+    uint64_t cache_generation = ResolveResultCache::new_generation();  // Result cache key
+    size_t config_hash = ResolveResultCache::config_hash(config);
+
+    // Guards the fragments and parsed trees: shared by resolves, exclusive
+    // for updates
+    mutable std::shared_mutex structure_mutex;
+
+    // Resolved values by fragment ID, kept across resolves
+    mutable std::mutex cache_mutex;
+    std::vector<ResolvedFragmentPtr> cache;
+
+    Impl(std::map<std::string, nlohmann::json> initial, JsonResolverConfig cfg)
+        : config(std::move(cfg))
+        , fragments(std::move(initial))
+        , parser(config, fragments) {
+        parser.compile_all();
+    }
+
+    ResolvedFragmentPtr find(FragmentId fragment) const override {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        return fragment < cache.size() ? cache[fragment] : nullptr;
+    }
+
+    void store(FragmentId fragment, ResolvedFragmentPtr value) override {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        if (fragment >= cache.size()) {
+            cache.resize(fragment + 1);
+        }
+        cache[fragment] = std::move(value);
+    }
+
+    // Evaluates a start fragment; callers hold the structure lock
+    nlohmann::json evaluate(const std::string& start_fragment);
+
+    // Drops the cached results of a fragment and everything depending on it
+    void invalidate(FragmentId fragment) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        for (FragmentId stale : parser.dependency_tracker().transitive_dependents(fragment)) {
+            if (stale < cache.size()) {
+                cache[stale].reset();
+            }
+        }
+    }
+};
+
+IncrementalResolver::IncrementalResolver(
+    std::map<std::string, nlohmann::json> fragments,
+    JsonResolverConfig config
+)
+    : impl_(std::make_unique<Impl>(std::move(fragments), std::move(config))) {}
+
+IncrementalResolver::~IncrementalResolver() = default;
+
+nlohmann::json IncrementalResolver::resolve(const std::string& start_fragment) const {
+    if (impl_->config.result_cache) {
+        return *resolve_shared(start_fragment);
+    }
+    std::shared_lock<std::shared_mutex> lock(impl_->structure_mutex);
+    return impl_->evaluate(start_fragment);
+}
+
+ResolvedFragmentPtr IncrementalResolver::resolve_shared(const std::string& start_fragment) const {
+    std::shared_lock<std::shared_mutex> lock(impl_->structure_mutex);
+    ResolveResultCache* cache = impl_->config.result_cache.get();
+    if (!cache) {
+        return std::make_shared<const nlohmann::json>(impl_->evaluate(start_fragment));
+    }
+
+    ResolveResultCache::Key key{impl_->cache_generation, start_fragment, impl_->config_hash};
+    if (ResolvedFragmentPtr cached = cache->find(key)) {
+        return cached;
+    }
+    auto value = std::make_shared<const nlohmann::json>(impl_->evaluate(start_fragment));
+    cache->store(std::move(key), value);
+    return value;
+}
+
+nlohmann::json IncrementalResolver::Impl::evaluate(const std::string& start_fragment) {
+    const CompiledFragments& compiled = parser.compiled();
+    FragmentId root = compiled.symbols.find(start_fragment);
+    if (!compiled.node(root)) {
+        throw FragmentNotFoundError(start_fragment);
+    }
+
+    ResolveBudget budget(config.limits);
+    EvaluationContext context(compiled, this);
+    context.set_budget(budget);
+    EvaluationContext::ScopedComponent path_component(context, start_fragment);
+    return *context.resolve_fragment(root, fragments, config);
+}
+
+void IncrementalResolver::update_fragment(const std::string& fragment_name, nlohmann::json value) {
+    std::unique_lock<std::shared_mutex> lock(impl_->structure_mutex);
+
+    auto [it, inserted] = impl_->fragments.try_emplace(fragment_name);
+    nlohmann::json previous = std::move(it->second);
+    it->second = std::move(value);
+
+    FragmentId fragment;
+    try {
+        fragment = impl_->parser.recompile_fragment(fragment_name, &it->second);
+    } catch (...) {
+        if (inserted) {
+            impl_->fragments.erase(it);
+        } else {
+            it->second = std::move(previous);
+        }
+        throw;
+    }
+
+    impl_->invalidate(fragment);
+    ++impl_->generation;
+    impl_->cache_generation = ResolveResultCache::new_generation();
+}
+
+void IncrementalResolver::remove_fragment(const std::string& fragment_name) {
+    std::unique_lock<std::shared_mutex> lock(impl_->structure_mutex);
+
+    auto it = impl_->fragments.find(fragment_name);
+    if (it == impl_->fragments.end()) {
+        return;
+    }
+
+    FragmentId fragment = impl_->parser.recompile_fragment(fragment_name, nullptr);
+    impl_->fragments.erase(it);
+    impl_->invalidate(fragment);
+    ++impl_->generation;
+    impl_->cache_generation = ResolveResultCache::new_generation();
+}
+
+size_t IncrementalResolver::cached_fragment_count() const {
+    std::lock_guard<std::mutex> lock(impl_->cache_mutex);
+    size_t count = 0;
+    for (const auto& value : impl_->cache) {
+        if (value) ++count;
+    }
+    return count;
+}
+
+uint64_t IncrementalResolver::generation() const {
+    std::shared_lock<std::shared_mutex> lock(impl_->structure_mutex);
+    return impl_->generation;
+}
+
+const JsonResolverConfig& IncrementalResolver::config() const {
+    return impl_->config;
+}
+
+} // namespace json_fragments
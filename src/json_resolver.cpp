@@ -1,150 +1,355 @@
 #include "json_fragments/fragment_nodes.hpp"
-#include "json_fragments/fragment_implementations.hpp"
 #include "json_fragments/json_resolver.hpp"
-#include "json_fragments/dependency_tracker.hpp"
 #include "json_fragments/exceptions.hpp"
+#include "fragment_parser.hpp"
+#include "batch_resolve.hpp"
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <set>
 
 namespace json_fragments {
 
-class FragmentParser {
-private:
-    EvaluationContext& context_;
-    const JsonResolverConfig& config_;
-    const std::map<std::string, nlohmann::json>& fragments_;
-    DependencyTracker dependency_tracker_;
-
-    // Helper class for RAII-style fragment evaluation
-    class FragmentEvaluationGuard {
-    private:
-        DependencyTracker& tracker_;
-        const std::string& fragment_name_;
-
-    public:
-        FragmentEvaluationGuard(DependencyTracker& tracker, const std::string& fragment_name)
-            : tracker_(tracker)
-            , fragment_name_(fragment_name) {
-            tracker_.begin_evaluation(fragment_name_);
-        }
+namespace {
 
-        ~FragmentEvaluationGuard() {
-            tracker_.end_evaluation(fragment_name_);
-        }
-    };
-    
-    // Helper method to check if a string is a complete fragment reference
-    bool is_complete_fragment_reference(const std::string& str) const {
-        return str.length() >= (config_.delimiters.start.length() + config_.delimiters.end.length()) &&
-               str.substr(0, config_.delimiters.start.length()) == config_.delimiters.start &&
-               str.substr(str.length() - config_.delimiters.end.length()) == config_.delimiters.end;
+// Parses what a start fragment reaches with delimiters known at compile
+// time, then hands its ID, root node and an evaluation context to finish
+template <typename Delimiters, typename Finish>
+void evaluate_start(
+    const JsonResolverConfig& config,
+    const FragmentSource& source,
+    const std::string& start_fragment,
+    ResolveStats* stats,
+    Finish&& finish
+) {
+    if (!source.find(start_fragment)) {
+        throw FragmentNotFoundError(start_fragment);
     }
-    
-    // Helper to extract the fragment name from a reference
-    std::string extract_fragment_name(const std::string& reference) const {
-        return reference.substr(
-            config_.delimiters.start.length(),
-            reference.length() - config_.delimiters.start.length() - config_.delimiters.end.length()
-        );
+
+    ResolveBudget budget(config.limits);
+    BasicFragmentParser<Delimiters> parser(config, source);
+    parser.collect_stats(stats);
+    parser.set_budget(budget);
+    const FragmentNode* root_node;
+    {
+        StatsTimer timer(stats ? &stats->parse_time : nullptr);
+        root_node = parser.compile_fragment(start_fragment);
     }
 
-    // Evaluates a fragment and its dependencies
-    void evaluate_fragment_dependencies(const std::string& fragment_name) {
-        auto it = fragments_.find(fragment_name);
-        if (it == fragments_.end()) {
-            return;  // Fragment not found, skip evaluation
-        }
+    // Every lookup goes through the source, so evaluation needs no map
+    EvaluationContext context(parser.compiled(), nullptr, &source, stats);
+    context.set_budget(budget);
+    EvaluationContext::ScopedComponent path_component(context, start_fragment);
+    StatsTimer timer(stats ? &stats->evaluate_time : nullptr);
+    finish(parser.compiled().symbols.find(start_fragment), *root_node, context);
+}
 
-        FragmentEvaluationGuard guard(dependency_tracker_, fragment_name);
-        parse(it->second, fragment_name);
+// Runs body with the delimiter set a resolver parses with
+template <typename Delimiters, typename Body>
+decltype(auto) with_resolver_delimiters(const JsonResolverConfig& config, Body&& body) {
+    if constexpr (std::is_same_v<Delimiters, ConfiguredDelimiters>) {
+        return with_delimiters(config, std::forward<Body>(body));
+    } else {
+        return body(Delimiters{});
     }
-    
+}
+
+const std::map<std::string, nlohmann::json> no_fragments;
+
+// Fragments delivered by an AsyncFragmentProvider so far. Looking up a name
+// that has not been asked for yet records it, so whatever parsing or
+// evaluation runs into can be fetched next.
+class FetchedFragments : public FragmentSource {
+    std::map<std::string, nlohmann::json, std::less<>> values_;
+    mutable std::set<std::string, std::less<>> requested_;
+    mutable std::vector<std::string> wanted_;
+    mutable std::mutex mutex_;  // Evaluation may look names up from several threads
+
 public:
-    FragmentParser(
-        EvaluationContext& context,
-        const JsonResolverConfig& config,
-        const std::map<std::string, nlohmann::json>& fragments
-    )
-        : context_(context)
-        , config_(config)
-        , fragments_(fragments) {}
-        
-    // Main entry point - converts JSON value into appropriate node type
-    FragmentNodePtr parse(const nlohmann::json& input, const std::string& current_fragment = "") {
-        if (input.is_string()) {
-            const std::string& str = input;
-            if (is_complete_fragment_reference(str)) {
-                std::string fragment_name = extract_fragment_name(str);
-                
-                if (!current_fragment.empty()) {
-                    dependency_tracker_.add_dependency(current_fragment, fragment_name);
-                    evaluate_fragment_dependencies(fragment_name);
-                }
+    const nlohmann::json* find(std::string_view name) const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = values_.find(name);
+        if (it != values_.end()) return &it->second;
+        if (requested_.emplace(name).second) wanted_.emplace_back(name);
+        return nullptr;
+    }
 
-                return std::make_unique<ReferenceNode>(fragment_name, context_);
-            }
-            
-            if (str.find(config_.delimiters.start) != std::string::npos) {
-                return std::make_unique<StringTemplateNode>(str, context_);
+    void for_each_name(const std::function<void(const std::string&)>& visit) const override {
+        for (const auto& entry : values_) visit(entry.first);
+    }
+
+    // Names looked up since the last call
+    std::vector<std::string> take_wanted() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::exchange(wanted_, {});
+    }
+
+    bool has_wanted() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !wanted_.empty();
+    }
+
+    // Keeps a fetched value, returning where it lives, or nullptr for a
+    // fragment that does not exist
+    const nlohmann::json* store(const std::string& name, std::optional<nlohmann::json> value) {
+        if (!value) return nullptr;
+        std::lock_guard<std::mutex> lock(mutex_);
+        return &values_.emplace(name, std::move(*value)).first->second;
+    }
+};
+
+// Fetches, parses and evaluates a start fragment and what it reaches
+template <typename Delimiters>
+nlohmann::json fetch_and_resolve(
+    const JsonResolverConfig& config,
+    AsyncFragmentProvider& provider,
+    const std::string& start_fragment,
+    ResolveStats* stats
+) {
+    // Time spent waiting for fetches counts against the time limit
+    ResolveBudget budget(config.limits);
+    FetchedFragments source;
+    BasicFragmentParser<Delimiters> parser(config, source);
+    parser.collect_stats(stats);
+    parser.set_budget(budget);
+
+    // Takes whichever fetch in flight finishes first. std::future cannot
+    // wait for several at once, so with more than one in flight the
+    // oldest is waited on in short slices between checks of the others.
+    std::deque<std::pair<std::string, std::future<std::optional<nlohmann::json>>>> in_flight;
+    auto next_arrival = [&] {
+        const auto slice = std::chrono::milliseconds(1);
+        for (;;) {
+            for (auto it = in_flight.begin(); it != in_flight.end(); ++it) {
+                if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                    auto arrival = std::move(*it);
+                    in_flight.erase(it);
+                    return arrival;
+                }
             }
-            
-            return std::make_unique<LiteralNode>(str);
+            budget.check_deadline();
+            auto now = std::chrono::steady_clock::now();
+            auto until = in_flight.size() > 1 ? now + slice : now + std::chrono::hours(1);
+            in_flight.front().second.wait_until(std::min(until, budget.deadline()));
         }
-        
-        if (input.is_object()) {
-            auto node = std::make_unique<ObjectNode>(context_);
-            for (auto it = input.begin(); it != input.end(); ++it) {
-                FragmentNodePtr key_node;
-                if (is_complete_fragment_reference(it.key())) {
-                    std::string fragment_name = extract_fragment_name(it.key());
-                    if (!current_fragment.empty()) {
-                        dependency_tracker_.add_dependency(current_fragment, fragment_name);
-                        evaluate_fragment_dependencies(fragment_name);
-                    }
-                    key_node = std::make_unique<ReferenceNode>(fragment_name, context_);
-                } else {
-                    key_node = std::make_unique<LiteralNode>(it.key());
+    };
+
+    // Waits for every fetch in flight. With parse set, each arrival is
+    // parsed and the names it refers to are fetched at once; without it,
+    // values are only kept, as lookups made while evaluating use them raw.
+    auto fetch_all = [&](bool parse) {
+        for (;;) {
+            std::vector<std::string> names = source.take_wanted();
+            if (!names.empty()) {
+                auto futures = provider.fetch(names);
+                if (futures.size() != names.size()) {
+                    throw JsonFragmentsError("Fragment provider returned " + std::to_string(futures.size()) +
+                                             " results for " + std::to_string(names.size()) + " names");
+                }
+                for (size_t i = 0; i < names.size(); ++i) {
+                    in_flight.emplace_back(std::move(names[i]), std::move(futures[i]));
                 }
-                    
-                node->add_entry(
-                    std::move(key_node),
-                    parse(it.value(), current_fragment)
-                );
             }
-            return node;
-        }
-        
-        if (input.is_array()) {
-            auto node = std::make_unique<ArrayNode>(context_);
-            for (const auto& element : input) {
-                node->add_element(parse(element, current_fragment));
+            if (in_flight.empty()) return;
+
+            auto [name, future] = next_arrival();
+            const nlohmann::json* value = source.store(name, future.get());
+            if (parse) {
+                StatsTimer timer(stats ? &stats->parse_time : nullptr);
+                parser.provide_fragment(name, value);
             }
-            return node;
         }
-        
-        return std::make_unique<LiteralNode>(input);
+    };
+
+    source.find(start_fragment);
+    fetch_all(true);
+    parser.check_for_cycles();
+
+    const FragmentNode* root = parser.compile_fragment(start_fragment);
+    if (!root) {
+        throw FragmentNotFoundError(start_fragment);
+    }
+
+    for (;;) {
+        EvaluationContext context(parser.compiled(), nullptr, &source, stats);
+        context.set_budget(budget);
+        EvaluationContext::ScopedComponent path_component(context, start_fragment);
+        try {
+            StatsTimer timer(stats ? &stats->evaluate_time : nullptr);
+            nlohmann::json result = context.evaluate_fragment(
+                parser.compiled().symbols.find(start_fragment), *root, no_fragments, config);
+            if (!source.has_wanted()) return result;
+        } catch (const ResourceLimitError&) {
+            throw;
+        } catch (const JsonFragmentsError&) {
+            // Templates rewrap errors, so any failure after looking up a
+            // name that has not been fetched may be due to it. Each retry
+            // follows a fetch of new names, so the loop ends.
+            if (!source.has_wanted()) throw;
+        }
+        fetch_all(false);
     }
-    
-    const auto& get_dependencies() const { return dependency_tracker_.get_dependencies(); }
-};
+}
 
-JsonResolver::JsonResolver(JsonResolverConfig config)
-    : config_(std::move(config)) {}
+} // namespace
 
-JsonResolver::~JsonResolver() = default;
+template <typename Delimiters>
+BasicJsonResolver<Delimiters>::BasicJsonResolver(JsonResolverConfig config)
+    : config_(std::move(config)) {
+    if constexpr (!std::is_same_v<Delimiters, ConfiguredDelimiters>) {
+        config_.delimiters.start = std::string(Delimiters::start);
+        config_.delimiters.end = std::string(Delimiters::end);
+    }
+}
 
-nlohmann::json JsonResolver::resolve(
+template <typename Delimiters>
+BasicJsonResolver<Delimiters>::~BasicJsonResolver() = default;
+
+template <typename Delimiters>
+nlohmann::json BasicJsonResolver<Delimiters>::resolve(
     const std::map<std::string, nlohmann::json>& fragments,
-    const std::string& start_fragment
-) {
-    auto it = fragments.find(start_fragment);
-    if (it == fragments.end()) {
-        throw FragmentNotFoundError(start_fragment);
-    }
-    
-    context_.push(start_fragment);
-    FragmentParser parser(context_, config_, fragments);
-    auto root_node = parser.parse(it->second, start_fragment);
-    
-    return root_node->evaluate(fragments, config_);
+    const std::string& start_fragment,
+    ResolveStats* stats
+) const {
+    return resolve(MapFragmentSource(fragments), start_fragment, stats);
+}
+
+template <typename Delimiters>
+nlohmann::json BasicJsonResolver<Delimiters>::resolve(
+    std::map<std::string, nlohmann::json>&& fragments,
+    const std::string& start_fragment,
+    ResolveStats* stats
+) const {
+    // Parallel forks may each evaluate a fragment, and nested templates
+    // read fragments by name, so both need the values left in place
+    const bool consume = !config_.parallel.pool &&
+        config_.template_expansion == JsonResolverConfig::TemplateExpansion::SinglePass;
+
+    MapFragmentSource source(fragments);
+    nlohmann::json result;
+    with_resolver_delimiters<Delimiters>(config_, [&](auto delimiters) {
+        evaluate_start<decltype(delimiters)>(config_, source, start_fragment, stats,
+            [&](FragmentId id, const FragmentNode& root, EvaluationContext& context) {
+                if (consume) context.consume_literals();
+                result = context.evaluate_fragment(id, root, no_fragments, config_);
+            });
+    });
+    return result;
+}
+
+template <typename Delimiters>
+void BasicJsonResolver<Delimiters>::resolve_to(
+    const std::map<std::string, nlohmann::json>& fragments,
+    const std::string& start_fragment,
+    std::ostream& out,
+    ResolveStats* stats
+) const {
+    resolve_to(MapFragmentSource(fragments), start_fragment, out, stats);
+}
+
+template <typename Delimiters>
+nlohmann::json BasicJsonResolver<Delimiters>::resolve(
+    const FragmentSource& source,
+    const std::string& start_fragment,
+    ResolveStats* stats
+) const {
+    nlohmann::json result;
+    with_resolver_delimiters<Delimiters>(config_, [&](auto delimiters) {
+        evaluate_start<decltype(delimiters)>(config_, source, start_fragment, stats,
+            [&](FragmentId id, const FragmentNode& root, EvaluationContext& context) {
+                result = context.evaluate_fragment(id, root, no_fragments, config_);
+            });
+    });
+    return result;
+}
+
+template <typename Delimiters>
+void BasicJsonResolver<Delimiters>::resolve_to(
+    const FragmentSource& source,
+    const std::string& start_fragment,
+    std::ostream& out,
+    ResolveStats* stats
+) const {
+    with_resolver_delimiters<Delimiters>(config_, [&](auto delimiters) {
+        evaluate_start<decltype(delimiters)>(config_, source, start_fragment, stats,
+            [&](FragmentId, const FragmentNode& root, EvaluationContext& context) {
+                JsonWriter writer(out);
+                root.write(no_fragments, config_, context, writer);
+            });
+    });
+}
+
+template <typename Delimiters>
+nlohmann::json BasicJsonResolver<Delimiters>::resolve_at(
+    const std::map<std::string, nlohmann::json>& fragments,
+    const std::string& start_fragment,
+    const nlohmann::json::json_pointer& pointer,
+    ResolveStats* stats
+) const {
+    return resolve_at(MapFragmentSource(fragments), start_fragment, pointer, stats);
+}
+
+template <typename Delimiters>
+nlohmann::json BasicJsonResolver<Delimiters>::resolve_at(
+    const FragmentSource& source,
+    const std::string& start_fragment,
+    const nlohmann::json::json_pointer& pointer,
+    ResolveStats* stats
+) const {
+    PointerPath path(pointer);
+    nlohmann::json result;
+    with_resolver_delimiters<Delimiters>(config_, [&](auto delimiters) {
+        evaluate_start<decltype(delimiters)>(config_, source, start_fragment, stats,
+            [&](FragmentId, const FragmentNode& root, EvaluationContext& context) {
+                result = context.evaluate_fragment_at(root, path, 0, no_fragments, config_);
+            });
+    });
+    return result;
+}
+
+template <typename Delimiters>
+std::vector<nlohmann::json> BasicJsonResolver<Delimiters>::resolve_many(
+    const std::map<std::string, nlohmann::json>& fragments,
+    const std::vector<std::string>& start_fragments,
+    ThreadPool* pool
+) const {
+    return with_resolver_delimiters<Delimiters>(config_, [&](auto delimiters) {
+        ResolveBudget budget(config_.limits);
+        BasicFragmentParser<decltype(delimiters)> parser(config_, fragments);
+        parser.set_budget(budget);
+        for (const auto& start_fragment : start_fragments) {
+            if (!parser.compile_fragment(start_fragment)) {
+                throw FragmentNotFoundError(start_fragment);
+            }
+        }
+        return resolve_batch(parser.compiled(), fragments, config_, start_fragments, pool, budget);
+    });
 }
 
-} // namespace json_fragments
\ No newline at end of file
+template <typename Delimiters>
+std::future<nlohmann::json> BasicJsonResolver<Delimiters>::resolve_async(
+    AsyncFragmentProvider& provider,
+    const std::string& start_fragment,
+    ResolveStats* stats
+) const {
+    // The configuration is copied, so the resolver need not outlive the call
+    return std::async(std::launch::async, [config = config_, &provider, start_fragment, stats] {
+        return with_resolver_delimiters<Delimiters>(config, [&](auto delimiters) {
+            return fetch_and_resolve<decltype(delimiters)>(config, provider, start_fragment, stats);
+        });
+    });
+}
+
+template <typename Delimiters>
+CompiledFragmentSet BasicJsonResolver<Delimiters>::compile(
+    std::map<std::string, nlohmann::json> fragments,
+    ThreadPool* pool
+) const {
+    return CompiledFragmentSet::compile(std::move(fragments), config_, pool);
+}
+
+template class BasicJsonResolver<ConfiguredDelimiters>;
+template class BasicJsonResolver<BracketDelimiters>;
+template class BasicJsonResolver<DoubleBraceDelimiters>;
+
+} // namespace json_fragments
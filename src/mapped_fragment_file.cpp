@@ -0,0 +1,210 @@
+#include "json_fragments/fragment_source.hpp"
+#include "json_fragments/exceptions.hpp"
+#include "file_view.hpp"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace json_fragments {
+
+namespace {
+
+// Where and why scanning failed, reported with the file's name
+struct ScanError {
+    std::string message;
+};
+
+// Finds the extent of each top-level member without building any values.
+// Only the structure needed to skip a value is checked here; the value
+// itself is validated when it is parsed.
+class TopLevelScanner {
+    const char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+
+public:
+    TopLevelScanner(const char* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename Visit>
+    void scan(Visit&& visit) {
+        skip_whitespace();
+        expect('{');
+        skip_whitespace();
+        if (peek() == '}') {
+            ++pos_;
+        } else {
+            while (true) {
+                skip_whitespace();
+                std::string name = read_key();
+                skip_whitespace();
+                expect(':');
+                skip_whitespace();
+                size_t begin = pos_;
+                skip_value();
+                if (pos_ == begin) fail("expected a value");
+                visit(std::move(name), begin, pos_);
+                skip_whitespace();
+                if (peek() == ',') {
+                    ++pos_;
+                    continue;
+                }
+                expect('}');
+                break;
+            }
+        }
+        skip_whitespace();
+        if (pos_ != size_) fail("unexpected content after the top-level object");
+    }
+
+private:
+    char peek() const { return pos_ < size_ ? data_[pos_] : '\0'; }
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw ScanError{what + " at byte " + std::to_string(pos_)};
+    }
+
+    void expect(char c) {
+        if (pos_ >= size_ || data_[pos_] != c) fail(std::string("expected '") + c + "'");
+        ++pos_;
+    }
+
+    void skip_whitespace() {
+        while (pos_ < size_ && (data_[pos_] == ' ' || data_[pos_] == '\t' ||
+                                data_[pos_] == '\n' || data_[pos_] == '\r')) {
+            ++pos_;
+        }
+    }
+
+    // Moves past a string starting at the current position, returning
+    // whether it contained escapes
+    bool skip_string() {
+        expect('"');
+        bool escaped = false;
+        while (pos_ < size_) {
+            char c = data_[pos_++];
+            if (c == '"') return escaped;
+            if (c == '\\') {
+                escaped = true;
+                ++pos_;
+            }
+        }
+        fail("unterminated string");
+    }
+
+    std::string read_key() {
+        size_t begin = pos_;
+        if (!skip_string()) {
+            return std::string(data_ + begin + 1, pos_ - begin - 2);
+        }
+        try {
+            return nlohmann::json::parse(data_ + begin, data_ + pos_).get<std::string>();
+        } catch (const nlohmann::json::exception& e) {
+            throw ScanError{"invalid key at byte " + std::to_string(begin) + ": " + e.what()};
+        }
+    }
+
+    void skip_value() {
+        size_t depth = 0;
+        while (pos_ < size_) {
+            char c = data_[pos_];
+            if (c == '"') {
+                skip_string();
+                if (depth == 0) return;
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if (c == '}' || c == ']') {
+                if (depth == 0) return;
+                if (--depth == 0) {
+                    ++pos_;
+                    return;
+                }
+            } else if (depth == 0 && (c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r')) {
+                return;
+            }
+            ++pos_;
+        }
+        if (depth > 0) fail("unterminated value");
+    }
+};
+
+} // namespace
+
+struct MappedFragmentFile::Impl {
+    static FileView open(const std::string& path) {
+        try {
+            return FileView(path);
+        } catch (const FileError& e) {
+            throw FragmentSourceError(e.message);
+        }
+    }
+
+    struct Entry {
+        size_t begin = 0;
+        size_t end = 0;
+        std::once_flag parse_once;
+        std::optional<nlohmann::json> value;
+    };
+
+    FileView file;
+    std::map<std::string, Entry, std::less<>> entries;
+    std::atomic<size_t> parsed{0};
+
+    explicit Impl(const std::string& path) : file(open(path)) {
+        try {
+            TopLevelScanner(file.data(), file.size()).scan(
+                [this](std::string name, size_t begin, size_t end) {
+                    Entry& entry = entries[std::move(name)];
+                    entry.begin = begin;
+                    entry.end = end;
+                });
+        } catch (const ScanError& e) {
+            throw FragmentSourceError("'" + path + "' is not a JSON object of fragments: " + e.message);
+        }
+    }
+};
+
+MappedFragmentFile::MappedFragmentFile(const std::string& path)
+    : impl_(std::make_unique<Impl>(path)) {}
+
+MappedFragmentFile::~MappedFragmentFile() = default;
+
+const nlohmann::json* MappedFragmentFile::find(std::string_view name) const {
+    auto it = impl_->entries.find(name);
+    if (it == impl_->entries.end()) {
+        return nullptr;
+    }
+
+    // A failed parse leaves the flag unset, so the error repeats on every lookup
+    Impl::Entry& entry = it->second;
+    std::call_once(entry.parse_once, [&] {
+        const char* data = impl_->file.data();
+        try {
+            entry.value = nlohmann::json::parse(data + entry.begin, data + entry.end);
+        } catch (const nlohmann::json::exception& e) {
+            throw FragmentSourceError("Invalid JSON in fragment '" + it->first + "': " + e.what());
+        }
+        ++impl_->parsed;
+    });
+    return &*entry.value;
+}
+
+void MappedFragmentFile::for_each_name(const std::function<void(const std::string&)>& visit) const {
+    for (const auto& entry : impl_->entries) {
+        visit(entry.first);
+    }
+}
+
+size_t MappedFragmentFile::size() const {
+    return impl_->entries.size();
+}
+
+size_t MappedFragmentFile::parsed_count() const {
+    return impl_->parsed.load();
+}
+
+} // namespace json_fragments
@@ -0,0 +1,90 @@
+#include "json_fragments/resolve_result_cache.hpp"
+#include <atomic>
+#include <functional>
+
+namespace json_fragments {
+
+namespace {
+
+size_t combine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+} // namespace
+
+ResolveResultCache::ResolveResultCache(size_t capacity)
+    : capacity_(capacity) {}
+
+ResolvedFragmentPtr ResolveResultCache::find(const Key& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+}
+
+void ResolveResultCache::store(Key key, ResolvedFragmentPtr value) {
+    if (capacity_ == 0) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        it->second->second = std::move(value);
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return;
+    }
+
+    if (entries_.size() == capacity_) {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+    entries_.emplace_front(key, std::move(value));
+    index_.emplace(std::move(key), entries_.begin());
+}
+
+void ResolveResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    index_.clear();
+    entries_.clear();
+}
+
+size_t ResolveResultCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+uint64_t ResolveResultCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint64_t ResolveResultCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+uint64_t ResolveResultCache::new_generation() {
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t ResolveResultCache::config_hash(const JsonResolverConfig& config) {
+    size_t hash = std::hash<std::string>{}(config.delimiters.start);
+    hash = combine(hash, std::hash<std::string>{}(config.delimiters.end));
+    hash = combine(hash, static_cast<size_t>(config.missing_fragment_behavior));
+    hash = combine(hash, std::hash<nlohmann::json>{}(config.default_value));
+    hash = combine(hash, static_cast<size_t>(config.template_expansion));
+    return hash;
+}
+
+size_t ResolveResultCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<std::string>{}(key.start_fragment);
+    hash = combine(hash, std::hash<uint64_t>{}(key.generation));
+    return combine(hash, key.config_hash);
+}
+
+} // namespace json_fragments
@@ -0,0 +1,204 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/exceptions.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+namespace {
+
+// Serves fragments from a map, answering each name on its own thread after
+// a delay, and records the batches it was asked for
+class MapProvider : public AsyncFragmentProvider {
+public:
+    std::map<std::string, json> fragments;
+    std::vector<std::vector<std::string>> batches;
+    std::chrono::milliseconds delay{0};
+    std::map<std::string, std::chrono::milliseconds> delays;  // Replace delay for some names
+    std::string failing;
+    std::vector<std::set<std::string>> answered_before;  // Names answered before each batch
+    std::set<std::string> answered;
+    std::mutex mutex;
+
+    std::vector<std::future<std::optional<json>>> fetch(const std::vector<std::string>& names) override {
+        batches.push_back(names);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            answered_before.push_back(answered);
+        }
+        std::vector<std::future<std::optional<json>>> futures;
+        for (const auto& name : names) {
+            auto it = delays.find(name);
+            auto wait = it != delays.end() ? it->second : delay;
+            futures.push_back(std::async(std::launch::async, [this, name, wait]() -> std::optional<json> {
+                std::this_thread::sleep_for(wait);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    answered.insert(name);
+                }
+                if (name == failing) throw std::runtime_error("store unavailable");
+                auto it = fragments.find(name);
+                if (it == fragments.end()) return std::nullopt;
+                return it->second;
+            }));
+        }
+        return futures;
+    }
+
+    std::vector<std::string> fetched() const {
+        std::vector<std::string> names;
+        for (const auto& batch : batches) names.insert(names.end(), batch.begin(), batch.end());
+        return names;
+    }
+};
+
+// Never answers, keeping the promises so their futures stay pending
+class HungProvider : public AsyncFragmentProvider {
+public:
+    std::vector<std::promise<std::optional<json>>> promises;
+
+    std::vector<std::future<std::optional<json>>> fetch(const std::vector<std::string>& names) override {
+        std::vector<std::future<std::optional<json>>> futures;
+        for (size_t i = 0; i < names.size(); ++i) {
+            promises.emplace_back();
+            futures.push_back(promises.back().get_future());
+        }
+        return futures;
+    }
+};
+
+} // namespace
+
+SCENARIO("Fragments can be fetched asynchronously while resolving", "[async]") {
+    GIVEN("A provider holding fragments three levels deep") {
+        MapProvider provider;
+        provider.fragments["first"] = "Alice";
+        provider.fragments["name"] = "[first] Smith";
+        provider.fragments["role"] = "admin";
+        provider.fragments["user"] = {{"name", "[name]"}, {"role", "[role]"}, {"again", "[name]"}};
+        provider.fragments["doc"] = {{"user", "[user]"}, {"title", "Hello, [name]"}};
+        provider.fragments["unused"] = "never fetched";
+
+        JsonResolver resolver;
+
+        WHEN("a fragment is resolved through the provider") {
+            json result = resolver.resolve_async(provider, "doc").get();
+
+            THEN("the result matches resolving the same fragments from a map") {
+                REQUIRE(result == resolver.resolve(provider.fragments, "doc"));
+            }
+
+            THEN("names found together are fetched together, and each only once") {
+                REQUIRE(provider.batches.size() == 4);
+                REQUIRE(provider.batches[0] == std::vector<std::string>{"doc"});
+                REQUIRE(provider.batches[1] == std::vector<std::string>{"name", "user"});
+                // Whichever of name and user arrives first is parsed first
+                std::set<std::vector<std::string>> last = {provider.batches[2], provider.batches[3]};
+                REQUIRE(last == std::set<std::vector<std::string>>{{"first"}, {"role"}});
+
+                auto names = provider.fetched();
+                std::sort(names.begin(), names.end());
+                REQUIRE(std::adjacent_find(names.begin(), names.end()) == names.end());
+                REQUIRE(std::find(names.begin(), names.end(), "unused") == names.end());
+            }
+        }
+
+        WHEN("fetches are slow") {
+            provider.delay = std::chrono::milliseconds(20);
+            provider.fragments["wide"] = json::array();
+            for (int i = 0; i < 10; ++i) {
+                std::string name = "item" + std::to_string(i);
+                provider.fragments[name] = i;
+                provider.fragments["wide"].push_back("[" + name + "]");
+            }
+
+            auto started = std::chrono::steady_clock::now();
+            json result = resolver.resolve_async(provider, "wide").get();
+            auto elapsed = std::chrono::steady_clock::now() - started;
+
+            THEN("the fetches of one batch overlap") {
+                REQUIRE(result.size() == 10);
+                REQUIRE(provider.batches.size() == 2);
+                REQUIRE(elapsed < std::chrono::milliseconds(20) * 10);
+            }
+        }
+
+        WHEN("an early fetch is slower than a later one") {
+            provider.delays["name"] = std::chrono::milliseconds(300);
+            json result = resolver.resolve_async(provider, "doc").get();
+
+            THEN("fragments that have arrived are parsed without waiting for it") {
+                REQUIRE(result == resolver.resolve(provider.fragments, "doc"));
+                auto role = std::find(provider.batches.begin(), provider.batches.end(),
+                                      std::vector<std::string>{"role"});
+                REQUIRE(role != provider.batches.end());
+                REQUIRE(provider.answered_before[role - provider.batches.begin()].count("name") == 0);
+            }
+        }
+
+        WHEN("resolving with statistics") {
+            ResolveStats stats;
+            resolver.resolve_async(provider, "doc", &stats).get();
+
+            THEN("parsing and evaluation are counted as for other resolves") {
+                REQUIRE(stats.object_nodes == 2);
+                REQUIRE(stats.fragments.count("name") == 1);
+            }
+        }
+    }
+
+    GIVEN("A template whose inner placeholder builds the name of another fragment") {
+        MapProvider provider;
+        provider.fragments["kind"] = "user";
+        provider.fragments["label_user"] = "User";
+        provider.fragments["title"] = "[label_[kind]]";
+
+        JsonResolverConfig config;
+        config.template_expansion = JsonResolverConfig::TemplateExpansion::Nested;
+        JsonResolver resolver(config);
+
+        THEN("the built name is fetched once evaluation finds it") {
+            REQUIRE(resolver.resolve_async(provider, "title").get() == "User");
+            REQUIRE(provider.batches.back() == std::vector<std::string>{"label_user"});
+        }
+    }
+
+    GIVEN("Fragments that cannot be resolved") {
+        MapProvider provider;
+        provider.fragments["a"] = {{"b", "[b]"}};
+        provider.fragments["b"] = {{"a", "[a]"}};
+        provider.fragments["broken"] = {{"value", "[missing]"}};
+        provider.fragments["remote"] = {{"value", "[flaky]"}};
+        provider.failing = "flaky";
+
+        JsonResolver resolver;
+
+        THEN("the errors of a synchronous resolve reach the future") {
+            REQUIRE_THROWS_AS(resolver.resolve_async(provider, "absent").get(), FragmentNotFoundError);
+            REQUIRE_THROWS_AS(resolver.resolve_async(provider, "broken").get(), FragmentNotFoundError);
+            REQUIRE_THROWS_AS(resolver.resolve_async(provider, "a").get(), CircularDependencyError);
+        }
+
+        THEN("a failed fetch fails the resolve") {
+            REQUIRE_THROWS_AS(resolver.resolve_async(provider, "remote").get(), std::runtime_error);
+        }
+    }
+
+    GIVEN("A provider that never answers") {
+        HungProvider provider;
+        JsonResolverConfig config;
+        config.limits.time_limit = std::chrono::milliseconds(50);
+
+        THEN("the time limit ends the wait") {
+            auto started = std::chrono::steady_clock::now();
+            REQUIRE_THROWS_AS(JsonResolver(config).resolve_async(provider, "doc").get(), ResourceLimitError);
+            REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::seconds(5));
+        }
+    }
+}
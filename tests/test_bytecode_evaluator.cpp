@@ -0,0 +1,123 @@
+#include <catch2/catch_test_macros.hpp>
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/incremental_resolver.hpp"
+#include "json_fragments/exceptions.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+namespace {
+
+JsonResolverConfig bytecode_config(JsonResolverConfig config = {}) {
+    config.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+    return config;
+}
+
+} // namespace
+
+SCENARIO("The bytecode engine resolves like the tree engine", "[bytecode]") {
+    GIVEN("Fragments using every kind of node") {
+        std::map<std::string, json> fragments;
+        fragments["name"] = "Alice";
+        fragments["field"] = "role";
+        fragments["role"] = {{"title", "admin"}, {"level", 3}};
+        fragments["empty"] = json::object();
+        fragments["user"] = {
+            {"name", "[name]"},
+            {"greeting", "Hello, [name]!"},
+            {"[field]", "[role]"},
+            {"tags", {"a", "[name]", {{"nested", json::array({1, "[field]"})}}}},
+            {"none", "[empty]"},
+            {"count", 12}
+        };
+
+        THEN("both engines produce the same document") {
+            JsonResolver tree;
+            JsonResolver bytecode(bytecode_config());
+            auto result = bytecode.resolve(fragments, "user");
+            REQUIRE(result == tree.resolve(fragments, "user"));
+            REQUIRE(result["role"]["title"] == "admin");
+            REQUIRE(result["tags"][2]["nested"][1] == "role");
+        }
+
+        THEN("compiled sets and batches agree too") {
+            auto tree = CompiledFragmentSet::compile(fragments);
+            auto bytecode = CompiledFragmentSet::compile(fragments, bytecode_config());
+            std::vector<std::string> starts{"user", "role", "name", "empty"};
+            REQUIRE(bytecode.resolve_many(starts) == tree.resolve_many(starts));
+
+            ThreadPool pool(2);
+            REQUIRE(bytecode.resolve_many(starts, &pool) == tree.resolve_many(starts));
+        }
+    }
+
+    GIVEN("References to missing fragments") {
+        std::map<std::string, json> fragments;
+        fragments["doc"] = {{"value", "[missing]"}, {"text", "x[missing]y"}, {"list", {"[missing]"}}};
+
+        THEN("each missing-fragment behavior matches the tree engine") {
+            using Behavior = JsonResolverConfig::MissingFragmentBehavior;
+            for (auto behavior : {Behavior::LeaveUnresolved, Behavior::UseDefault, Behavior::Remove}) {
+                JsonResolverConfig config;
+                config.missing_fragment_behavior = behavior;
+                config.default_value = "N/A";
+                REQUIRE(JsonResolver(bytecode_config(config)).resolve(fragments, "doc") ==
+                        JsonResolver(config).resolve(fragments, "doc"));
+            }
+        }
+
+        THEN("throwing behavior still throws") {
+            REQUIRE_THROWS_AS(
+                JsonResolver(bytecode_config()).resolve(fragments, "doc"),
+                FragmentNotFoundError
+            );
+        }
+    }
+
+    GIVEN("An object key that resolves to a non-string") {
+        std::map<std::string, json> fragments;
+        fragments["number"] = 42;
+        fragments["doc"] = {{"[number]", "value"}};
+
+        THEN("it throws an appropriate exception") {
+            REQUIRE_THROWS_AS(
+                JsonResolver(bytecode_config()).resolve(fragments, "doc"),
+                InvalidKeyError
+            );
+        }
+    }
+
+    GIVEN("A template whose placeholder resolves to a non-string") {
+        std::map<std::string, json> fragments;
+        fragments["number"] = 42;
+        fragments["doc"] = {{"list", {"value: [number]"}}};
+
+        THEN("the error names the same path as the tree engine") {
+            std::string tree_message;
+            std::string bytecode_message;
+            try { JsonResolver().resolve(fragments, "doc"); }
+            catch (const JsonFragmentsError& e) { tree_message = e.what(); }
+            try { JsonResolver(bytecode_config()).resolve(fragments, "doc"); }
+            catch (const JsonFragmentsError& e) { bytecode_message = e.what(); }
+            REQUIRE_FALSE(bytecode_message.empty());
+            REQUIRE(bytecode_message == tree_message);
+        }
+    }
+
+    GIVEN("An incremental resolver using the bytecode engine") {
+        std::map<std::string, json> fragments;
+        fragments["host"] = "example.com";
+        fragments["service"] = {{"url", "https://[host]/api"}};
+        IncrementalResolver resolver(fragments, bytecode_config());
+
+        WHEN("a fragment is updated") {
+            REQUIRE(resolver.resolve("service")["url"] == "https://example.com/api");
+            resolver.update_fragment("host", "example.org");
+
+            THEN("the recompiled program sees the new value") {
+                REQUIRE(resolver.resolve("service")["url"] == "https://example.org/api");
+            }
+        }
+    }
+}
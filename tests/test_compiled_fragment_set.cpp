@@ -0,0 +1,255 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/exceptions.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+SCENARIO("CompiledFragmentSet resolves repeatedly without re-parsing", "[compiled]") {
+    GIVEN("A compiled set of fragments") {
+        std::map<std::string, json> fragments;
+        fragments["name"] = "Bob";
+        fragments["greeting"] = {
+            {"message", "Hello, [name]!"}
+        };
+        fragments["user"] = {
+            {"id", 7},
+            {"name", "[name]"}
+        };
+
+        auto compiled = CompiledFragmentSet::compile(fragments);
+
+        THEN("it knows about every fragment") {
+            REQUIRE(compiled.size() == 3);
+            REQUIRE(compiled.contains("greeting"));
+            REQUIRE_FALSE(compiled.contains("missing"));
+        }
+
+        WHEN("resolving different start fragments") {
+            auto greeting = compiled.resolve("greeting");
+            auto user = compiled.resolve("user");
+
+            THEN("each result matches the uncompiled resolver") {
+                JsonResolver resolver;
+                REQUIRE(greeting == resolver.resolve(fragments, "greeting"));
+                REQUIRE(user == resolver.resolve(fragments, "user"));
+                REQUIRE(greeting["message"] == "Hello, Bob!");
+                REQUIRE(user["name"] == "Bob");
+            }
+        }
+
+        WHEN("resolving the same start fragment twice") {
+            THEN("the results are identical") {
+                REQUIRE(compiled.resolve("greeting") == compiled.resolve("greeting"));
+            }
+        }
+
+        WHEN("resolving a fragment that is not in the set") {
+            THEN("it throws an appropriate exception") {
+                REQUIRE_THROWS_AS(compiled.resolve("missing"), FragmentNotFoundError);
+            }
+        }
+    }
+
+    GIVEN("A resolver with custom delimiters") {
+        JsonResolverConfig config;
+        config.delimiters.start = "{{";
+        config.delimiters.end = "}}";
+        JsonResolver resolver(config);
+
+        std::map<std::string, json> fragments;
+        fragments["host"] = "example.com";
+        fragments["url"] = "https://{{host}}/api";
+
+        WHEN("compiling through the resolver") {
+            auto compiled = resolver.compile(fragments);
+
+            THEN("the resolver's configuration is used") {
+                REQUIRE(compiled.resolve("url") == "https://example.com/api");
+            }
+        }
+    }
+
+    GIVEN("Fragments with a circular reference") {
+        std::map<std::string, json> fragments;
+        fragments["A"] = {"ref", "[B]"};
+        fragments["B"] = {"ref", "[A]"};
+
+        THEN("the cycle is detected at compile time") {
+            REQUIRE_THROWS_AS(
+                CompiledFragmentSet::compile(fragments),
+                CircularDependencyError
+            );
+        }
+    }
+}
+
+SCENARIO("CompiledFragmentSet can be resolved from many threads at once", "[compiled][threads]") {
+    GIVEN("A compiled set shared between threads") {
+        std::map<std::string, json> fragments;
+        fragments["base"] = {{"host", "example.com"}, {"port", 8080}};
+        fragments["url"] = "https://[host]/api";
+        fragments["host"] = "example.com";
+        for (int i = 0; i < 16; ++i) {
+            fragments["service" + std::to_string(i)] = {
+                {"id", i},
+                {"base", "[base]"},
+                {"url", "[url]"}
+            };
+        }
+        const auto compiled = CompiledFragmentSet::compile(fragments);
+
+        WHEN("every thread resolves every service repeatedly") {
+            std::atomic<int> mismatches{0};
+            std::vector<std::thread> workers;
+            for (int t = 0; t < 8; ++t) {
+                workers.emplace_back([&] {
+                    for (int round = 0; round < 50; ++round) {
+                        for (int i = 0; i < 16; ++i) {
+                            auto result = compiled.resolve("service" + std::to_string(i));
+                            if (result["id"] != i ||
+                                result["base"]["port"] != 8080 ||
+                                result["url"] != "https://example.com/api") {
+                                ++mismatches;
+                            }
+                        }
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+
+            THEN("all results are correct") {
+                REQUIRE(mismatches == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Fragment sets can resolve many start fragments in one call", "[compiled][batch]") {
+    GIVEN("Entry fragments that share common dependencies") {
+        std::map<std::string, json> fragments;
+        fragments["region"] = "eu-west";
+        fragments["base"] = {{"region", "[region]"}, {"retries", 3}};
+        std::vector<std::string> starts;
+        for (int i = 0; i < 40; ++i) {
+            std::string name = "entry" + std::to_string(i);
+            fragments[name] = {{"id", i}, {"base", "[base]"}, {"label", "[region]-" + std::to_string(i)}};
+            starts.push_back(name);
+        }
+        // A start that is also a dependency of another start
+        fragments["wrapper"] = {{"inner", "[entry3]"}};
+        starts.push_back("wrapper");
+        starts.push_back("entry3");
+
+        auto check = [&](const std::vector<json>& results) {
+            REQUIRE(results.size() == starts.size());
+            for (int i = 0; i < 40; ++i) {
+                REQUIRE(results[i]["id"] == i);
+                REQUIRE(results[i]["base"]["region"] == "eu-west");
+                REQUIRE(results[i]["label"] == "eu-west-" + std::to_string(i));
+            }
+            REQUIRE(results[40]["inner"]["id"] == 3);
+            REQUIRE(results[41] == results[3]);
+        };
+
+        WHEN("resolving them through JsonResolver") {
+            JsonResolver resolver;
+
+            THEN("results come back in order") {
+                check(resolver.resolve_many(fragments, starts));
+            }
+
+            THEN("a thread pool gives the same results") {
+                ThreadPool pool(4);
+                check(resolver.resolve_many(fragments, starts, &pool));
+            }
+        }
+
+        WHEN("resolving them through a compiled set") {
+            auto compiled = CompiledFragmentSet::compile(fragments);
+
+            THEN("results come back in order") {
+                check(compiled.resolve_many(starts));
+            }
+
+            THEN("a thread pool gives the same results") {
+                ThreadPool pool(4);
+                check(compiled.resolve_many(starts, &pool));
+            }
+        }
+
+        WHEN("one of the starts is missing") {
+            starts.push_back("missing");
+
+            THEN("it throws an appropriate exception") {
+                JsonResolver resolver;
+                REQUIRE_THROWS_AS(resolver.resolve_many(fragments, starts), FragmentNotFoundError);
+            }
+        }
+    }
+}
+
+SCENARIO("Fragment sets can be compiled on several threads", "[compiled][threads][parallel_compile]") {
+    GIVEN("A large set with references, templates, dynamic keys and missing fragments") {
+        std::map<std::string, json> fragments;
+        for (int i = 0; i < 2000; ++i) {
+            std::string next = "f" + std::to_string(i + 1);
+            json fragment = {{"id", i}, {"label", "item [l" + std::to_string(i) + "]"}};
+            if (i + 1 < 2000) fragment["next"] = "[" + next + "]";
+            if (i % 7 == 0) fragment["[l" + std::to_string(i) + "]"] = "keyed";
+            if (i % 97 == 0) fragment["lost"] = "[missing" + std::to_string(i) + "]";
+            fragments["f" + std::to_string(i)] = fragment;
+            fragments["l" + std::to_string(i)] = "label " + std::to_string(i);
+        }
+
+        JsonResolverConfig config;
+        config.missing_fragment_behavior = JsonResolverConfig::MissingFragmentBehavior::LeaveUnresolved;
+        ThreadPool pool(3);
+
+        WHEN("compiling it serially and in parallel") {
+            auto serial = CompiledFragmentSet::compile(fragments, config);
+            auto parallel = CompiledFragmentSet::compile(fragments, config, &pool);
+
+            THEN("both hold the same fragments and resolve the same way") {
+                REQUIRE(parallel.size() == serial.size());
+                for (int i = 0; i < 2000; i += 131) {
+                    std::string name = "f" + std::to_string(i);
+                    REQUIRE(parallel.resolve(name) == serial.resolve(name));
+
+                    std::ostringstream serial_text, parallel_text;
+                    serial.resolve_to(name, serial_text);
+                    parallel.resolve_to(name, parallel_text);
+                    REQUIRE(parallel_text.str() == serial_text.str());
+                }
+            }
+        }
+
+        WHEN("compiling it in parallel for the bytecode engine") {
+            JsonResolverConfig bytecode = config;
+            bytecode.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+            auto parallel = CompiledFragmentSet::compile(fragments, bytecode, &pool);
+
+            THEN("results match the tree engine") {
+                auto serial = CompiledFragmentSet::compile(fragments, config);
+                REQUIRE(parallel.resolve("f1900") == serial.resolve("f1900"));
+            }
+        }
+
+        WHEN("the last fragment refers back to the first") {
+            fragments["f1999"]["next"] = "[f0]";
+
+            THEN("the parallel compile reports the cycle") {
+                REQUIRE_THROWS_AS(CompiledFragmentSet::compile(fragments, config, &pool),
+                                  CircularDependencyError);
+            }
+        }
+    }
+}
@@ -0,0 +1,233 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/exceptions.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+namespace {
+
+// A file path that is removed again when the test is done with it
+class TemporaryPath {
+    std::string path_;
+
+public:
+    TemporaryPath()
+        : path_((std::filesystem::temp_directory_path() /
+                 ("json_fragments_" + std::to_string(std::random_device{}()) + ".plan")).string()) {}
+    ~TemporaryPath() { std::remove(path_.c_str()); }
+
+    const std::string& path() const { return path_; }
+};
+
+void save(const CompiledFragmentSet& compiled, const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    compiled.save(out);
+}
+
+std::string read(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write(const std::string& path, const std::string& contents) {
+    std::ofstream(path, std::ios::binary) << contents;
+}
+
+// A plan stores a length before each string and a u32 after a reference's
+// kind byte, both in the byte order of the machine that wrote it
+std::string u32_bytes(uint32_t value) {
+    return std::string(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// The ID a plan gives a fragment is the position of its name in its table
+uint32_t plan_id(const std::string& plan, const std::vector<std::string>& names, const std::string& name) {
+    auto position = [&](const std::string& n) {
+        return plan.find(u32_bytes(static_cast<uint32_t>(n.size())) + n);
+    };
+    uint32_t id = 0;
+    for (const auto& other : names) {
+        if (position(other) < position(name)) ++id;
+    }
+    return id;
+}
+
+} // namespace
+
+SCENARIO("Compiled sets can be saved and loaded without recompiling", "[plan]") {
+    GIVEN("A compiled set using every kind of node") {
+        std::map<std::string, json> fragments;
+        fragments["name"] = "Zoë";
+        fragments["field"] = "alpha";
+        fragments["shared"] = {{"pi", 3.141592653589793}, {"list", {1, nullptr, false}}, {"empty", json::object()}};
+        fragments["user"] = {
+            {"name", "[name]"},
+            {"greeting", "Hi [name], your field is [field]!"},
+            {"[field]", "dynamic key"},
+            {"rows", {"[shared]", {{"k", "[field]"}}, "plain", 42}},
+            {"lost", "[missing]"}
+        };
+        fragments["alias"] = "[user]";
+
+        JsonResolverConfig config;
+        config.missing_fragment_behavior = JsonResolverConfig::MissingFragmentBehavior::LeaveUnresolved;
+        auto compiled = CompiledFragmentSet::compile(fragments, config);
+
+        TemporaryPath plan;
+        save(compiled, plan.path());
+
+        WHEN("loading the plan") {
+            auto loaded = CompiledFragmentSet::load(plan.path(), config);
+
+            THEN("it holds the same fragments") {
+                REQUIRE(loaded.size() == compiled.size());
+                REQUIRE(loaded.contains("user"));
+                REQUIRE_FALSE(loaded.contains("missing"));
+            }
+
+            THEN("every fragment resolves as it did before saving") {
+                for (const auto& [name, value] : fragments) {
+                    REQUIRE(loaded.resolve(name) == compiled.resolve(name));
+                }
+            }
+
+            THEN("streaming produces the same text") {
+                std::ostringstream before, after;
+                compiled.resolve_to("user", before);
+                loaded.resolve_to("user", after);
+                REQUIRE(after.str() == before.str());
+            }
+
+            THEN("saving it again produces the same plan") {
+                TemporaryPath again;
+                save(loaded, again.path());
+                REQUIRE(read(again.path()) == read(plan.path()));
+            }
+        }
+
+        WHEN("loading the plan for the bytecode engine") {
+            JsonResolverConfig bytecode = config;
+            bytecode.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+            auto loaded = CompiledFragmentSet::load(plan.path(), bytecode);
+
+            THEN("results are unchanged") {
+                REQUIRE(loaded.resolve("alias") == compiled.resolve("alias"));
+            }
+        }
+
+        WHEN("the loaded set outlives the set it was saved from") {
+            auto loaded = CompiledFragmentSet::load(plan.path(), config);
+            compiled = CompiledFragmentSet::compile({}, config);
+
+            THEN("it still resolves") {
+                REQUIRE(loaded.resolve("user")["greeting"] == "Hi Zoë, your field is alpha!");
+            }
+        }
+
+        WHEN("loading with different delimiters") {
+            JsonResolverConfig other = config;
+            other.delimiters.start = "{{";
+            other.delimiters.end = "}}";
+
+            THEN("it throws an appropriate exception") {
+                REQUIRE_THROWS_AS(CompiledFragmentSet::load(plan.path(), other), PlanFormatError);
+            }
+        }
+
+        WHEN("the plan is truncated") {
+            std::string contents = read(plan.path());
+            TemporaryPath truncated;
+
+            THEN("every prefix is rejected") {
+                for (size_t length = 0; length < contents.size(); ++length) {
+                    write(truncated.path(), contents.substr(0, length));
+                    REQUIRE_THROWS_AS(CompiledFragmentSet::load(truncated.path(), config), PlanFormatError);
+                }
+            }
+        }
+
+        WHEN("the plan has been damaged") {
+            std::string contents = read(plan.path());
+            TemporaryPath damaged;
+
+            THEN("damage either loads or is rejected, but never crashes") {
+                for (size_t i = 8; i < contents.size(); ++i) {
+                    std::string copy = contents;
+                    copy[i] = static_cast<char>(~copy[i]);
+                    write(damaged.path(), copy);
+                    try {
+                        CompiledFragmentSet::load(damaged.path(), config);
+                    } catch (const PlanFormatError&) {
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN("A plan edited so that its fragments refer to each other in a loop") {
+        std::map<std::string, json> fragments;
+        fragments["first"] = "[second]";
+        fragments["second"] = "[third]";
+        fragments["third"] = "end";
+
+        TemporaryPath plan;
+        save(CompiledFragmentSet::compile(fragments), plan.path());
+
+        // Point the reference to "third" back at "first"
+        std::string contents = read(plan.path());
+        std::vector<std::string> names = {"first", "second", "third"};
+        const char reference_kind = 2;
+        std::string to_third = reference_kind + u32_bytes(plan_id(contents, names, "third"));
+        size_t at = contents.find(to_third);
+        REQUIRE(at != std::string::npos);
+        contents.replace(at, to_third.size(), reference_kind + u32_bytes(plan_id(contents, names, "first")));
+        write(plan.path(), contents);
+
+        THEN("loading it throws an appropriate exception") {
+            REQUIRE_THROWS_AS(CompiledFragmentSet::load(plan.path()), PlanFormatError);
+        }
+    }
+
+    GIVEN("A plan edited to nest arrays far deeper than any document") {
+        std::map<std::string, json> fragments;
+        fragments["doc"] = 1;
+
+        TemporaryPath plan;
+        save(CompiledFragmentSet::compile(fragments), plan.path());
+
+        // The plan ends with doc's tree, the literal 1; replace it with
+        // arrays of one element each, nested 100000 deep
+        std::string contents = read(plan.path());
+        const char literal_kind = 0, array_kind = 5;
+        std::string literal = literal_kind + u32_bytes(1) + "1";
+        REQUIRE(contents.substr(contents.size() - literal.size()) == literal);
+        contents.resize(contents.size() - literal.size());
+        for (int i = 0; i < 100000; ++i) contents += array_kind + u32_bytes(1);
+        write(plan.path(), contents);
+
+        THEN("loading it throws an appropriate exception instead of overflowing the stack") {
+            REQUIRE_THROWS_AS(CompiledFragmentSet::load(plan.path()), PlanFormatError);
+        }
+    }
+
+    GIVEN("A file that is not a plan") {
+        TemporaryPath path;
+        write(path.path(), R"({"not": "a plan"})");
+
+        THEN("loading it throws an appropriate exception") {
+            REQUIRE_THROWS_AS(CompiledFragmentSet::load(path.path()), PlanFormatError);
+        }
+    }
+
+    GIVEN("A path that does not exist") {
+        THEN("loading it throws an appropriate exception") {
+            REQUIRE_THROWS_AS(CompiledFragmentSet::load("/nonexistent/fragments.plan"), PlanFormatError);
+        }
+    }
+}
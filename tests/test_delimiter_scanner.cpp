@@ -0,0 +1,60 @@
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <string>
+#include <vector>
+#include "json_fragments/delimiter_scanner.hpp"
+
+using namespace json_fragments;
+
+SCENARIO("DelimiterScanner finds the same positions as std::string_view::find", "[scanner]") {
+    GIVEN("Delimiters of several lengths") {
+        const std::vector<std::string> delimiters{"[", "]", "{{", "}}", "${", "<%=", "[[[["};
+
+        WHEN("searching random text that often contains parts of them") {
+            std::mt19937 rng(7);
+            const std::string alphabet = "ab[]{}$<%=";
+
+            THEN("every search from every start position agrees") {
+                for (size_t length : {0, 1, 2, 15, 16, 17, 31, 32, 33, 63, 64, 65, 200}) {
+                    for (int round = 0; round < 20; ++round) {
+                        std::string text;
+                        for (size_t i = 0; i < length; ++i) {
+                            text += alphabet[rng() % alphabet.size()];
+                        }
+                        for (const auto& delimiter : delimiters) {
+                            for (size_t pos = 0; pos <= length + 1; ++pos) {
+                                REQUIRE(DelimiterScanner::find(text, delimiter, pos) ==
+                                        std::string_view(text).find(delimiter, pos));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        WHEN("a delimiter sits at the very end of a long string") {
+            THEN("it is found") {
+                for (const auto& delimiter : delimiters) {
+                    for (size_t length = 0; length < 80; ++length) {
+                        std::string text(length, 'x');
+                        text += delimiter;
+                        REQUIRE(DelimiterScanner::find(text, delimiter) == length);
+                        REQUIRE(DelimiterScanner::contains(text, delimiter));
+                        text.pop_back();
+                        REQUIRE(DelimiterScanner::find(text, delimiter) ==
+                                std::string_view(text).find(delimiter));
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN("Text with no delimiter characters at all") {
+        std::string text(1000, 'z');
+
+        THEN("it is rejected") {
+            REQUIRE_FALSE(DelimiterScanner::contains(text, "["));
+            REQUIRE_FALSE(DelimiterScanner::contains(text, "{{"));
+        }
+    }
+}
@@ -0,0 +1,172 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+#include "json_fragments/dependency_tracker.hpp"
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/exceptions.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+using Catch::Matchers::ContainsSubstring;
+
+SCENARIO("DependencyTracker detects cycles in a single pass", "[tracker]") {
+    GIVEN("A tracker with an acyclic graph") {
+        DependencyTracker tracker;
+        tracker.add_dependency("A", "B");
+        tracker.add_dependency("A", "C");
+        tracker.add_dependency("B", "C");
+        tracker.add_dependency("B", "C");
+
+        THEN("no cycle is reported") {
+            REQUIRE_NOTHROW(tracker.check_for_cycles());
+        }
+
+        THEN("duplicate edges are recorded once") {
+            auto dependencies = tracker.get_dependencies();
+            REQUIRE(dependencies["A"] == std::set<std::string>{"B", "C"});
+            REQUIRE(dependencies["B"] == std::set<std::string>{"C"});
+        }
+    }
+
+    GIVEN("A tracker whose graph contains a cycle, recorded by ID") {
+        SymbolTable symbols;
+        DependencyTracker tracker(symbols);
+        auto record = [&](const char* dependent, const char* dependency) {
+            tracker.add_dependency(symbols.intern(dependent), symbols.intern(dependency));
+        };
+        record("root", "A");
+        record("A", "B");
+        record("B", "C");
+        REQUIRE_NOTHROW(record("C", "A"));
+
+        THEN("the cycle is reported with its members in order") {
+            REQUIRE_THROWS_WITH(
+                tracker.check_for_cycles(),
+                "Circular dependency detected: A -> B -> C -> A"
+            );
+        }
+
+        THEN("checking through one of its members finds it too") {
+            REQUIRE_THROWS_WITH(
+                tracker.check_for_cycles_through("B"),
+                "Circular dependency detected: B -> C -> A -> B"
+            );
+            REQUIRE_NOTHROW(tracker.check_for_cycles_through("root"));
+        }
+    }
+
+    GIVEN("A tracker recording dependencies by name") {
+        DependencyTracker tracker;
+        tracker.add_dependency("root", "A");
+        tracker.add_dependency("A", "B");
+        tracker.add_dependency("B", "C");
+
+        THEN("the edge that closes a cycle throws straight away") {
+            REQUIRE_THROWS_WITH(
+                tracker.add_dependency("C", "A"),
+                "Circular dependency detected: C -> A -> B -> C"
+            );
+        }
+
+        THEN("a self loop throws straight away") {
+            REQUIRE_THROWS_WITH(
+                tracker.add_dependency("self", "self"),
+                "Circular dependency detected: self -> self"
+            );
+        }
+    }
+
+    GIVEN("A tracker with a very long dependency chain") {
+        DependencyTracker tracker;
+        const int length = 100000;
+        for (int i = 0; i < length; ++i) {
+            tracker.add_dependency(std::to_string(i), std::to_string(i + 1));
+        }
+
+        THEN("checking it does not exhaust the stack") {
+            REQUIRE_NOTHROW(tracker.check_for_cycles());
+        }
+
+        WHEN("the chain is closed into a loop") {
+            REQUIRE_THROWS_AS(tracker.add_dependency(std::to_string(length), "0"),
+                              CircularDependencyError);
+
+            THEN("the cycle is also found by a later full check") {
+                REQUIRE_THROWS_AS(tracker.check_for_cycles(), CircularDependencyError);
+            }
+        }
+    }
+
+    GIVEN("A tracker used while walking fragments") {
+        DependencyTracker tracker;
+        tracker.begin_evaluation("A");
+        tracker.begin_evaluation("B");
+
+        THEN("re-entering a fragment still being evaluated is a cycle") {
+            REQUIRE_THROWS_WITH(
+                tracker.begin_evaluation("A"),
+                "Circular dependency detected: A -> B -> A"
+            );
+        }
+
+        THEN("a finished fragment may be evaluated again") {
+            tracker.end_evaluation("B");
+            REQUIRE_NOTHROW(tracker.begin_evaluation("B"));
+        }
+    }
+}
+
+SCENARIO("JsonResolver reports the cycle it found", "[tracker]") {
+    GIVEN("Fragments with a three-step circular reference") {
+        JsonResolver resolver;
+        std::map<std::string, json> fragments;
+        fragments["A"] = {"ref", "[B]"};
+        fragments["B"] = {"ref", "[C]"};
+        fragments["C"] = {"ref", "[A]"};
+
+        THEN("the message names the whole cycle") {
+            REQUIRE_THROWS_WITH(
+                resolver.resolve(fragments, "A"),
+                ContainsSubstring("A -> B -> C -> A")
+            );
+        }
+    }
+}
+
+SCENARIO("SymbolTable interns fragment names into dense IDs", "[tracker]") {
+    GIVEN("A symbol table") {
+        SymbolTable symbols;
+
+        WHEN("interning names") {
+            auto user = symbols.intern("user");
+            auto role = symbols.intern("role");
+
+            THEN("IDs are dense and stable") {
+                REQUIRE(user == 0);
+                REQUIRE(role == 1);
+                REQUIRE(symbols.intern("user") == user);
+                REQUIRE(symbols.size() == 2);
+                REQUIRE(symbols.name(role) == "role");
+            }
+
+            THEN("unknown names are not interned by lookups") {
+                REQUIRE(symbols.find("missing") == SymbolTable::npos);
+                REQUIRE(symbols.size() == 2);
+            }
+        }
+
+        WHEN("a tracker shares the table") {
+            DependencyTracker tracker(symbols);
+            auto a = symbols.intern("A");
+            auto b = symbols.intern("B");
+            tracker.add_dependency(a, b);
+            tracker.add_dependency(b, a);
+
+            THEN("cycles are reported by name") {
+                REQUIRE_THROWS_WITH(
+                    tracker.check_for_cycles(),
+                    "Circular dependency detected: A -> B -> A"
+                );
+            }
+        }
+    }
+}
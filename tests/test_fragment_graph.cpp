@@ -0,0 +1,113 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+#include <algorithm>
+#include <sstream>
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/fragment_graph.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+SCENARIO("Compiled sets expose their dependency graph", "[graph]") {
+    GIVEN("A set with a long chain, a template and a shared fragment") {
+        std::map<std::string, json> fragments;
+        fragments["first"] = "Alice";
+        fragments["name"] = "[first] Smith";
+        fragments["greeting"] = "Hello, [name]!";
+        fragments["user"] = {{"name", "[name]"}, {"again", "[name]"}, {"tags", {"[greeting]", 1}}};
+        fragments["other"] = {{"first", "[first]"}};
+        fragments["unused"] = 1;
+
+        auto compiled = CompiledFragmentSet::compile(fragments);
+        FragmentGraph graph = compiled.dependency_graph();
+
+        THEN("every reference is one edge") {
+            std::map<std::string, std::set<std::string>> expected = {
+                {"greeting", {"name"}},
+                {"name", {"first"}},
+                {"other", {"first"}},
+                {"user", {"greeting", "name"}}
+            };
+            REQUIRE(graph.dependencies() == expected);
+            REQUIRE(graph.size() == fragments.size());
+        }
+
+        THEN("the longest chains start at fragments nothing refers to") {
+            auto chains = graph.longest_chains(10);
+            REQUIRE(chains.size() == 3);
+            REQUIRE(chains[0] == std::vector<std::string>{"user", "greeting", "name", "first"});
+            REQUIRE(chains[1] == std::vector<std::string>{"other", "first"});
+            REQUIRE(chains[2] == std::vector<std::string>{"unused"});
+            REQUIRE(graph.longest_chains(1).size() == 1);
+        }
+
+        THEN("the DOT form has a node per fragment and an edge per reference") {
+            std::ostringstream out;
+            graph.write_dot(out);
+            std::string dot = out.str();
+            REQUIRE_THAT(dot, Catch::Matchers::StartsWith("digraph fragments {"));
+            REQUIRE_THAT(dot, Catch::Matchers::ContainsSubstring("\"user\" -> \"greeting\";"));
+            REQUIRE_THAT(dot, Catch::Matchers::ContainsSubstring("\"name\" -> \"first\";"));
+        }
+
+        WHEN("a resolve is profiled") {
+            ResolveStats profile;
+            profile.measure_output = true;
+            auto result = compiled.resolve("user", &profile);
+
+            THEN("each evaluated fragment records the size of its output") {
+                REQUIRE(profile.fragments.at("name").output_bytes == json("Alice Smith").dump().size());
+                REQUIRE(profile.fragments.at("greeting").output_bytes == json("Hello, Alice Smith!").dump().size());
+            }
+
+            THEN("the JSON report carries the profile and the hottest fragments") {
+                json report = graph.to_json(&profile);
+                REQUIRE(report["fragments"]["user"]["dependencies"] == json({"greeting", "name"}));
+                REQUIRE(report["fragments"]["name"]["evaluations"] == 1);
+                REQUIRE(report["fragments"]["name"].contains("time_ns"));
+                REQUIRE(report["fragments"]["name"]["output_bytes"] == 13);
+                REQUIRE_FALSE(report["fragments"]["first"].contains("evaluations"));
+                REQUIRE(report["fragments"]["user"]["evaluations"] == 1);
+                REQUIRE(report["hottest"].size() == 3);
+                REQUIRE(std::find(report["hottest"].begin(), report["hottest"].end(), "user") !=
+                        report["hottest"].end());
+                REQUIRE(report["longest_chains"][0][0] == "user");
+            }
+
+            THEN("the DOT form labels evaluated fragments") {
+                std::ostringstream out;
+                graph.write_dot(out, &profile);
+                REQUIRE_THAT(out.str(), Catch::Matchers::ContainsSubstring("\"name\\n1 evaluations, "));
+                REQUIRE_THAT(out.str(), Catch::Matchers::ContainsSubstring("fillcolor"));
+            }
+        }
+    }
+
+    GIVEN("A set that refers to a missing fragment") {
+        std::map<std::string, json> fragments;
+        fragments["doc"] = {{"value", "[absent]"}};
+        JsonResolverConfig config;
+        config.missing_fragment_behavior = JsonResolverConfig::MissingFragmentBehavior::LeaveUnresolved;
+
+        FragmentGraph graph = CompiledFragmentSet::compile(fragments, config).dependency_graph();
+
+        THEN("the missing fragment is a node marked as missing") {
+            json report = graph.to_json();
+            REQUIRE(report["fragments"]["absent"]["missing"] == true);
+            REQUIRE(report["fragments"]["doc"]["dependencies"] == json({"absent"}));
+            REQUIRE_FALSE(report.contains("hottest"));
+        }
+
+        THEN("a missing fragment in a profile's hottest stays dashed as well as filled") {
+            // As from resolving a map that still had the fragment
+            ResolveStats profile;
+            profile.fragments["absent"].evaluations = 1;
+            profile.fragments["absent"].time = std::chrono::milliseconds(5);
+
+            std::ostringstream out;
+            graph.write_dot(out, &profile);
+            REQUIRE_THAT(out.str(), Catch::Matchers::ContainsSubstring("style=\"dashed,filled\", fillcolor"));
+            REQUIRE(out.str().find("style=", out.str().find("style=") + 1) == std::string::npos);
+        }
+    }
+}
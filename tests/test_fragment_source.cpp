@@ -0,0 +1,173 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/fragment_source.hpp"
+#include "json_fragments/exceptions.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+namespace {
+
+// A file that is removed again when the test is done with it
+class TemporaryFile {
+    std::string path_;
+
+public:
+    explicit TemporaryFile(const std::string& contents)
+        : path_((std::filesystem::temp_directory_path() /
+                 ("json_fragments_" + std::to_string(std::random_device{}()) + ".json")).string()) {
+        std::ofstream(path_, std::ios::binary) << contents;
+    }
+    ~TemporaryFile() { std::remove(path_.c_str()); }
+
+    const std::string& path() const { return path_; }
+};
+
+} // namespace
+
+SCENARIO("Fragments can be resolved lazily from a mapped file", "[source]") {
+    GIVEN("A file of fragments, only some of which one start fragment needs") {
+        std::map<std::string, json> fragments;
+        fragments["name"] = "Bob";
+        fragments["greeting"] = {{"message", "Hello, [name]!"}, {"tags", {"a", "[name]"}}};
+        fragments["config"] = {{"nested", {{"depth", {1, 2, {{"x", "}]\"["}}}}}}};
+        fragments["unused"] = {{"big", json::array({1, 2, 3})}, {"text", "[missing]"}};
+        fragments["number"] = -12.5e3;
+        fragments["flag"] = true;
+        fragments["nothing"] = nullptr;
+        TemporaryFile file(json(fragments).dump(2));
+
+        MappedFragmentFile source(file.path());
+
+        THEN("every fragment is indexed but none is parsed") {
+            REQUIRE(source.size() == fragments.size());
+            REQUIRE(source.parsed_count() == 0);
+        }
+
+        WHEN("resolving one start fragment") {
+            JsonResolver resolver;
+            auto result = resolver.resolve(source, "greeting");
+
+            THEN("it matches resolving the same fragments from a map") {
+                REQUIRE(result == resolver.resolve(fragments, "greeting"));
+            }
+
+            THEN("only the fragments it reaches are parsed") {
+                REQUIRE(source.parsed_count() == 2);
+            }
+        }
+
+        WHEN("looking up each fragment directly") {
+            THEN("every value round-trips, scalars and awkward strings included") {
+                for (const auto& [name, value] : fragments) {
+                    const json* found = source.find(name);
+                    REQUIRE(found);
+                    REQUIRE(*found == value);
+                }
+                REQUIRE(source.find("absent") == nullptr);
+            }
+        }
+
+        WHEN("streaming a start fragment") {
+            JsonResolver resolver;
+            std::ostringstream out;
+            resolver.resolve_to(source, "greeting", out);
+
+            THEN("the output matches the resolved value") {
+                REQUIRE(out.str() == resolver.resolve(fragments, "greeting").dump());
+            }
+        }
+
+        WHEN("resolving a start fragment that is not in the file") {
+            THEN("it throws an appropriate exception") {
+                JsonResolver resolver;
+                REQUIRE_THROWS_AS(resolver.resolve(source, "absent"), FragmentNotFoundError);
+            }
+        }
+    }
+
+    GIVEN("A file with escaped and repeated names") {
+        TemporaryFile file(R"({"a\"b": 1, "café": "[a\"b]", "dup": 1, "dup": 2})");
+        MappedFragmentFile source(file.path());
+
+        THEN("names are unescaped and the last duplicate wins") {
+            REQUIRE(source.size() == 3);
+            REQUIRE(*source.find("dup") == 2);
+            REQUIRE(JsonResolver().resolve(source, "caf\xc3\xa9") == 1);
+        }
+    }
+
+    GIVEN("A file whose top level is not an object") {
+        TemporaryFile file("[1, 2, 3]");
+
+        THEN("opening it throws an appropriate exception") {
+            REQUIRE_THROWS_AS(MappedFragmentFile(file.path()), FragmentSourceError);
+        }
+    }
+
+    GIVEN("A file with a malformed fragment value") {
+        TemporaryFile file(R"({"good": {"x": 1}, "bad": {"x": tru}})");
+        MappedFragmentFile source(file.path());
+
+        THEN("only looking up the bad fragment fails") {
+            REQUIRE(*source.find("good") == json{{"x", 1}});
+            REQUIRE_THROWS_AS(source.find("bad"), FragmentSourceError);
+        }
+    }
+
+    GIVEN("A path that does not exist") {
+        THEN("opening it throws an appropriate exception") {
+            REQUIRE_THROWS_AS(MappedFragmentFile("/nonexistent/fragments.json"), FragmentSourceError);
+        }
+    }
+}
+
+SCENARIO("Fragments can be resolved from a flat hash table", "[source][table]") {
+    GIVEN("A table built from a map") {
+        std::map<std::string, json> fragments;
+        fragments["name"] = "Bob";
+        fragments["greeting"] = {{"message", "Hello, [name]!"}, {"who", "[name]"}};
+        FragmentTable table(fragments);
+
+        THEN("resolving matches resolving the map") {
+            JsonResolver resolver;
+            REQUIRE(table.size() == 2);
+            REQUIRE(resolver.resolve(table, "greeting") == resolver.resolve(fragments, "greeting"));
+        }
+
+        WHEN("a fragment is replaced") {
+            table.insert_or_assign("name", "Alice");
+
+            THEN("the new value is used and no entry is added") {
+                REQUIRE(table.size() == 2);
+                REQUIRE(JsonResolver().resolve(table, "greeting")["who"] == "Alice");
+            }
+        }
+    }
+
+    GIVEN("A table with many fragments, grown without reserving") {
+        FragmentTable table;
+        for (int i = 0; i < 5000; ++i) {
+            table.insert_or_assign("fragment_" + std::to_string(i), i);
+        }
+
+        THEN("every fragment is found and absent names are not") {
+            for (int i = 0; i < 5000; ++i) {
+                const json* value = table.find("fragment_" + std::to_string(i));
+                REQUIRE(value);
+                REQUIRE(*value == i);
+            }
+            REQUIRE(table.find("fragment_5000") == nullptr);
+            REQUIRE(table.find("") == nullptr);
+
+            size_t names = 0;
+            table.for_each_name([&](const std::string&) { ++names; });
+            REQUIRE(names == 5000);
+        }
+    }
+}
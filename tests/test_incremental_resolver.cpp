@@ -0,0 +1,98 @@
+#include <catch2/catch_test_macros.hpp>
+#include "json_fragments/incremental_resolver.hpp"
+#include "json_fragments/exceptions.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+SCENARIO("IncrementalResolver re-resolves only what a change affects", "[incremental]") {
+    GIVEN("A resolver whose fragments depend on a shared base") {
+        std::map<std::string, json> fragments;
+        fragments["host"] = "example.com";
+        fragments["base"] = {{"url", "https://[host]/api"}};
+        fragments["service"] = {{"name", "orders"}, {"base", "[base]"}};
+        fragments["unrelated"] = {{"answer", 42}};
+        fragments["other"] = {{"config", "[unrelated]"}};
+
+        IncrementalResolver resolver(fragments);
+
+        WHEN("everything has been resolved once") {
+            REQUIRE(resolver.resolve("service")["base"]["url"] == "https://example.com/api");
+            REQUIRE(resolver.resolve("other")["config"]["answer"] == 42);
+
+            THEN("every resolved fragment with references is cached") {
+                // host and unrelated have no references and need no caching
+                REQUIRE(resolver.cached_fragment_count() == 3);
+            }
+
+            AND_WHEN("a leaf fragment changes") {
+                resolver.update_fragment("host", "example.org");
+
+                THEN("only it and its dependents are invalidated") {
+                    REQUIRE(resolver.cached_fragment_count() == 1);
+                    REQUIRE(resolver.generation() == 1);
+                }
+
+                THEN("the next resolve sees the new value") {
+                    REQUIRE(resolver.resolve("service")["base"]["url"] == "https://example.org/api");
+                    REQUIRE(resolver.resolve("other")["config"]["answer"] == 42);
+                    REQUIRE(resolver.cached_fragment_count() == 3);
+                }
+            }
+
+            AND_WHEN("a fragment's dependencies change") {
+                resolver.update_fragment("base", {{"url", "static"}, {"extra", "[unrelated]"}});
+
+                THEN("the new dependency is tracked") {
+                    REQUIRE(resolver.resolve("service")["base"]["extra"]["answer"] == 42);
+                    resolver.update_fragment("unrelated", {{"answer", 43}});
+                    REQUIRE(resolver.resolve("service")["base"]["extra"]["answer"] == 43);
+                }
+
+                THEN("the old dependency no longer invalidates it") {
+                    resolver.resolve("service");
+                    size_t cached = resolver.cached_fragment_count();
+                    resolver.update_fragment("host", "example.net");
+                    REQUIRE(resolver.cached_fragment_count() == cached);
+                }
+            }
+        }
+
+        WHEN("a fragment that was missing is added") {
+            JsonResolverConfig config;
+            config.missing_fragment_behavior = JsonResolverConfig::MissingFragmentBehavior::UseDefault;
+            config.default_value = "unset";
+            fragments["uses_later"] = {{"value", "[later]"}};
+            IncrementalResolver lenient(fragments, config);
+            REQUIRE(lenient.resolve("uses_later")["value"] == "unset");
+
+            lenient.update_fragment("later", "set");
+
+            THEN("fragments that referenced it pick it up") {
+                REQUIRE(lenient.resolve("uses_later")["value"] == "set");
+            }
+
+            AND_WHEN("it is removed again") {
+                lenient.remove_fragment("later");
+
+                THEN("the references are missing again") {
+                    REQUIRE(lenient.resolve("uses_later")["value"] == "unset");
+                    REQUIRE_THROWS_AS(lenient.resolve("later"), FragmentNotFoundError);
+                }
+            }
+        }
+
+        WHEN("an update would create a cycle") {
+            THEN("it is rejected and the set is unchanged") {
+                REQUIRE_THROWS_AS(
+                    resolver.update_fragment("host", "[service]"),
+                    CircularDependencyError
+                );
+                REQUIRE(resolver.generation() == 0);
+                REQUIRE(resolver.resolve("service")["base"]["url"] == "https://example.com/api");
+                resolver.update_fragment("host", "example.org");
+                REQUIRE(resolver.resolve("service")["base"]["url"] == "https://example.org/api");
+            }
+        }
+    }
+}
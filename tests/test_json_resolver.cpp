@@ -4,6 +4,7 @@
 #include <catch2/catch_approx.hpp> 
 #include "json_fragments/json_resolver.hpp"
 #include "json_fragments/exceptions.hpp"
+#include <sstream>
 
 using json = nlohmann::json;
 using namespace json_fragments;
@@ -249,3 +250,438 @@ SCENARIO("JsonResolver handles LLM-style tool calls", "[resolver]") {
         }
     }
 }
+
+
+SCENARIO("JsonResolver resolves references recursively", "[resolver]") {
+    GIVEN("A JsonResolver and fragments that reference other fragments") {
+        JsonResolver resolver;
+        std::map<std::string, json> fragments;
+
+        fragments["permissions"] = json::array({"read", "write"});
+        fragments["role"] = {
+            {"title", "Admin"},
+            {"permissions", "[permissions]"}
+        };
+        fragments["host"] = "example.com";
+        fragments["endpoint"] = "https://[host]/api";
+        fragments["user"] = {
+            {"name", "Alice"},
+            {"role", "[role]"},
+            {"api", "[endpoint]"},
+            {"docs", "See [endpoint]/docs"}
+        };
+
+        WHEN("resolving a fragment whose references have references") {
+            auto result = resolver.resolve(fragments, "user");
+
+            THEN("every level is substituted") {
+                REQUIRE(result["role"]["title"] == "Admin");
+                REQUIRE(result["role"]["permissions"] == json::array({"read", "write"}));
+                REQUIRE(result["api"] == "https://example.com/api");
+                REQUIRE(result["docs"] == "See https://example.com/api/docs");
+            }
+        }
+
+        WHEN("the same fragment is referenced from many places") {
+            fragments["many"] = json::array({"[role]", "[role]", "[role]"});
+            auto result = resolver.resolve(fragments, "many");
+
+            THEN("every occurrence receives the resolved value") {
+                REQUIRE(result.size() == 3);
+                for (const auto& element : result) {
+                    REQUIRE(element["permissions"] == json::array({"read", "write"}));
+                }
+            }
+        }
+    }
+
+    GIVEN("A template that references its own fragment") {
+        JsonResolver resolver;
+        std::map<std::string, json> fragments;
+        fragments["loop"] = "again and [loop]";
+
+        THEN("the cycle is detected instead of expanding forever") {
+            REQUIRE_THROWS_AS(
+                resolver.resolve(fragments, "loop"),
+                CircularDependencyError
+            );
+        }
+    }
+}
+
+SCENARIO("JsonResolver expands string templates", "[resolver][template]") {
+    GIVEN("Fragments used as template placeholders") {
+        std::map<std::string, json> fragments;
+        fragments["protocol"] = "https";
+        fragments["domain"] = "example.com";
+        fragments["port"] = "8080";
+        fragments["url"] = "[protocol]://[domain]:[port]/api/[domain]";
+        fragments["suffix"] = "x";
+        fragments["namex"] = "composed";
+        fragments["composed"] = "[name[suffix]]";
+        fragments["missing"] = "Hello, [nobody]!";
+
+        WHEN("using the default single-pass expansion") {
+            JsonResolver resolver;
+
+            THEN("every placeholder is substituted once, in order") {
+                REQUIRE(resolver.resolve(fragments, "url") ==
+                        "https://example.com:8080/api/example.com");
+            }
+
+            THEN("substituted text is not expanded again") {
+                REQUIRE(resolver.resolve(fragments, "composed") == "[namex]");
+            }
+        }
+
+        WHEN("using nested expansion") {
+            JsonResolverConfig config;
+            config.template_expansion = JsonResolverConfig::TemplateExpansion::Nested;
+            JsonResolver resolver(config);
+
+            THEN("placeholders composed from other placeholders are resolved") {
+                REQUIRE(resolver.resolve(fragments, "composed") == "composed");
+                REQUIRE(resolver.resolve(fragments, "url") ==
+                        "https://example.com:8080/api/example.com");
+            }
+        }
+
+        WHEN("a placeholder names a missing fragment") {
+            JsonResolverConfig config;
+
+            THEN("it is handled according to the configured behavior") {
+                config.missing_fragment_behavior =
+                    JsonResolverConfig::MissingFragmentBehavior::LeaveUnresolved;
+                REQUIRE(JsonResolver(config).resolve(fragments, "missing") == "Hello, [nobody]!");
+
+                config.missing_fragment_behavior =
+                    JsonResolverConfig::MissingFragmentBehavior::UseDefault;
+                config.default_value = "N/A";
+                REQUIRE(JsonResolver(config).resolve(fragments, "missing") == "Hello, N/A!");
+
+                config.missing_fragment_behavior =
+                    JsonResolverConfig::MissingFragmentBehavior::Remove;
+                REQUIRE(JsonResolver(config).resolve(fragments, "missing") == "Hello, !");
+
+                config.missing_fragment_behavior =
+                    JsonResolverConfig::MissingFragmentBehavior::Throw;
+                REQUIRE_THROWS_AS(JsonResolver(config).resolve(fragments, "missing"),
+                                  JsonFragmentsError);
+            }
+        }
+    }
+}
+
+SCENARIO("JsonResolver can evaluate wide containers in parallel", "[resolver][threads]") {
+    GIVEN("A fragment with a very wide array and object") {
+        std::map<std::string, json> fragments;
+        fragments["host"] = "example.com";
+        fragments["base"] = {{"host", "[host]"}};
+
+        json elements = json::array();
+        json entries = json::object();
+        for (int i = 0; i < 5000; ++i) {
+            elements.push_back("https://[host]/item/" + std::to_string(i));
+            entries["key" + std::to_string(i)] = {{"index", i}, {"base", "[base]"}};
+        }
+        fragments["items"] = elements;
+        fragments["table"] = entries;
+        fragments["document"] = {{"items", "[items]"}, {"table", "[table]"}};
+
+        auto sequential = JsonResolver().resolve(fragments, "document");
+
+        WHEN("parallel evaluation is enabled") {
+            JsonResolverConfig config;
+            config.parallel.pool = std::make_shared<ThreadPool>(4);
+            config.parallel.min_children = 100;
+            JsonResolver resolver(config);
+
+            auto parallel = resolver.resolve(fragments, "document");
+
+            THEN("the result matches sequential evaluation") {
+                REQUIRE(parallel == sequential);
+                REQUIRE(parallel["items"][4999] == "https://example.com/item/4999");
+                REQUIRE(parallel["table"]["key17"]["base"]["host"] == "example.com");
+            }
+        }
+
+        WHEN("an element fails during parallel evaluation") {
+            fragments["items"].push_back("[missing]");
+            JsonResolverConfig config;
+            config.parallel.pool = std::make_shared<ThreadPool>(4);
+            config.parallel.min_children = 100;
+            JsonResolver resolver(config);
+
+            THEN("the error reaches the caller") {
+                REQUIRE_THROWS_AS(resolver.resolve(fragments, "document"), FragmentNotFoundError);
+            }
+        }
+    }
+}
+
+SCENARIO("JsonResolver hands out reference-free values without rebuilding them", "[resolver][literal]") {
+    GIVEN("Fragments mixing reference-free subtrees with references") {
+        std::map<std::string, json> fragments;
+        fragments["settings"] = {
+            {"limits", {{"cpu", 4}, {"memory", "16Gi"}}},
+            {"flags", {true, false, nullptr, 1.5}},
+            {"note", "brackets ] alone are fine"}
+        };
+        fragments["user"] = {{"name", "Alice"}, {"tags", {"a", "b"}}};
+        fragments["once"] = {{"user", "[user]"}, {"static", {{"deep", {1, 2, 3}}}}};
+        fragments["twice"] = {{"again", "[shared]"}, {"label", "[shared_name]"}};
+        fragments["shared"] = {{"value", "[settings]"}};
+        fragments["shared_name"] = "shared";
+        fragments["doc"] = {
+            {"settings", "[settings]"},
+            {"once", "[once]"},
+            {"shared", "[shared]"},
+            {"twice", "[twice]"},
+            {"unclosed", "[not a reference"},
+            {"mixed", {{"static", {1, 2}}, {"dynamic", "[shared_name]"}}}
+        };
+
+        WHEN("resolving the document") {
+            JsonResolver resolver;
+            auto result = resolver.resolve(fragments, "doc");
+
+            THEN("reference-free subtrees come through unchanged") {
+                REQUIRE(result["settings"] == fragments["settings"]);
+                REQUIRE(result["once"]["static"] == fragments["once"]["static"]);
+                REQUIRE(result["unclosed"] == "[not a reference");
+                REQUIRE(result["mixed"]["static"] == json({1, 2}));
+            }
+
+            THEN("fragments referenced once or many times both resolve") {
+                REQUIRE(result["once"]["user"] == fragments["user"]);
+                REQUIRE(result["shared"]["value"] == fragments["settings"]);
+                REQUIRE(result["twice"]["again"] == result["shared"]);
+                REQUIRE(result["twice"]["label"] == "shared");
+                REQUIRE(result["mixed"]["dynamic"] == "shared");
+            }
+
+            THEN("a compiled set and a batch including referenced fragments agree") {
+                auto compiled = CompiledFragmentSet::compile(fragments);
+                REQUIRE(compiled.resolve("doc") == result);
+                auto batch = compiled.resolve_many({"once", "doc", "user"});
+                REQUIRE(batch[0] == result["once"]);
+                REQUIRE(batch[1] == result);
+                REQUIRE(batch[2] == fragments["user"]);
+            }
+        }
+    }
+}
+
+SCENARIO("Resolvers with compile-time delimiters match configured ones", "[resolver][delimiters]") {
+    GIVEN("The same fragments written with bracket and double-brace delimiters") {
+        std::map<std::string, json> brackets;
+        brackets["host"] = "example.com";
+        brackets["field"] = "region";
+        brackets["service"] = {
+            {"url", "https://[host]/[field]"},
+            {"[field]", "eu"},
+            {"raw", "[[not closed"},
+            {"list", {"[host]", "plain ] text [", {{"k", "[field]"}}}}
+        };
+        std::map<std::string, json> braces;
+        braces["host"] = "example.com";
+        braces["field"] = "region";
+        braces["service"] = {
+            {"url", "https://{{host}}/{{field}}"},
+            {"{{field}}", "eu"},
+            {"raw", "{{{{not closed"},
+            {"list", {"{{host}}", "plain }} text {{", {{"k", "{{field}}"}}}}
+        };
+
+        JsonResolverConfig brace_config;
+        brace_config.delimiters.start = "{{";
+        brace_config.delimiters.end = "}}";
+
+        WHEN("resolving with each kind of resolver") {
+            auto configured = JsonResolver().resolve(brackets, "service");
+
+            THEN("the results are identical") {
+                REQUIRE(BasicJsonResolver<BracketDelimiters>().resolve(brackets, "service") == configured);
+                REQUIRE(BasicJsonResolver<DoubleBraceDelimiters>().resolve(braces, "service") ==
+                        JsonResolver(brace_config).resolve(braces, "service"));
+                REQUIRE(configured["url"] == "https://example.com/region");
+                REQUIRE(configured["region"] == "eu");
+                REQUIRE(configured["raw"] == "[[not closed");
+                REQUIRE(configured["list"][1] == "plain ] text [");
+            }
+        }
+
+        WHEN("a compile-time resolver is given other delimiters") {
+            BasicJsonResolver<BracketDelimiters> resolver(brace_config);
+
+            THEN("its own delimiters win") {
+                REQUIRE(resolver.config().delimiters.start == "[");
+                REQUIRE(resolver.resolve(brackets, "service")["url"] == "https://example.com/region");
+            }
+        }
+
+        WHEN("the configured delimiters are not a built-in set") {
+            std::map<std::string, json> angles;
+            angles["host"] = "example.com";
+            angles["url"] = "https://<<host>>/";
+            JsonResolverConfig config;
+            config.delimiters.start = "<<";
+            config.delimiters.end = ">>";
+
+            THEN("they are still honoured") {
+                REQUIRE(JsonResolver(config).resolve(angles, "url") == "https://example.com/");
+            }
+        }
+    }
+}
+
+SCENARIO("Errors report the path to where they happened", "[resolver][errors]") {
+    GIVEN("A template deep inside objects and arrays that refers to a non-string") {
+        std::map<std::string, json> fragments;
+        fragments["number"] = 42;
+        fragments["doc"] = {{"items", {1, {{"label", "value: [number]"}}}}};
+
+        auto message_for = [&](const JsonResolverConfig& config) {
+            try {
+                JsonResolver(config).resolve(fragments, "doc");
+            } catch (const JsonFragmentsError& e) {
+                return std::string(e.what());
+            }
+            return std::string();
+        };
+
+        THEN("the message names every key and index on the way") {
+            JsonResolverConfig config;
+            REQUIRE_THAT(message_for(config), Catch::Matchers::EndsWith(" at /doc/items/1/label"));
+
+            config.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+            REQUIRE_THAT(message_for(config), Catch::Matchers::EndsWith(" at /doc/items/1/label"));
+
+            config.engine = JsonResolverConfig::EvaluationEngine::Tree;
+            config.template_expansion = JsonResolverConfig::TemplateExpansion::Nested;
+            REQUIRE_THAT(message_for(config), Catch::Matchers::EndsWith(" at /doc/items/1/label"));
+        }
+    }
+}
+
+SCENARIO("Objects with literal keys resolve like objects with dynamic keys", "[resolver][object]") {
+    GIVEN("An object with only literal keys and one whose keys are references") {
+        std::map<std::string, json> fragments;
+        fragments["id"] = 7;
+        fragments["key_b"] = "b";
+        fragments["static"] = {{"c", "[id]"}, {"a", 1}, {"b", {{"nested", "[id]"}}}};
+        fragments["dynamic"] = {{"[key_b]", 2}, {"b", 3}, {"a", "[id]"}};
+        fragments["doc"] = {{"static", "[static]"}, {"dynamic", "[dynamic]"}};
+
+        JsonResolverConfig config;
+        auto resolve_with = [&](const JsonResolverConfig& c) {
+            return JsonResolver(c).resolve(fragments, "doc");
+        };
+
+        WHEN("the document is resolved") {
+            auto result = resolve_with(config);
+
+            THEN("literal keys keep their values in sorted order") {
+                REQUIRE(result["static"] == json({{"a", 1}, {"b", {{"nested", 7}}}, {"c", 7}}));
+                REQUIRE(result["static"].begin().key() == "a");
+            }
+
+            THEN("a dynamic key that repeats a literal one still takes one value") {
+                REQUIRE(result["dynamic"].size() == 2);
+                REQUIRE(result["dynamic"]["a"] == 7);
+                REQUIRE(result["dynamic"].contains("b"));
+            }
+
+            THEN("streaming, the bytecode engine and parallel evaluation agree") {
+                std::ostringstream out;
+                JsonResolver(config).resolve_to(fragments, "doc", out);
+                REQUIRE(out.str() == result.dump());
+
+                JsonResolverConfig bytecode;
+                bytecode.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+                REQUIRE(resolve_with(bytecode) == result);
+
+                JsonResolverConfig parallel;
+                parallel.parallel.pool = std::make_shared<ThreadPool>(2);
+                parallel.parallel.min_children = 2;
+                REQUIRE(resolve_with(parallel) == result);
+            }
+
+            THEN("a JSON pointer finds a literal key") {
+                REQUIRE(JsonResolver(config).resolve_at(fragments, "doc", json::json_pointer("/static/b/nested")) == 7);
+                REQUIRE_THROWS_AS(JsonResolver(config).resolve_at(fragments, "doc", json::json_pointer("/static/d")),
+                                  PointerNotFoundError);
+            }
+        }
+    }
+}
+
+SCENARIO("JsonResolver can consume the fragments it is given", "[resolver][consume]") {
+    GIVEN("Fragments with literal subtrees, a shared fragment and a template") {
+        auto make_fragments = [] {
+            std::map<std::string, json> fragments;
+            fragments["text"] = std::string(1000, 'x');
+            fragments["shared"] = {{"id", 7}};
+            fragments["name"] = "Ada";
+            fragments["doc"] = {
+                {"meta", {{"tags", {"a", "b"}}, {"size", 2}}},
+                {"text", "[text]"},
+                {"first", "[shared]"},
+                {"second", "[shared]"},
+                {"greeting", "Hello, [name]"}
+            };
+            return fragments;
+        };
+        const auto original = make_fragments();
+        auto expected = JsonResolver().resolve(original, "doc");
+
+        WHEN("the map is moved into resolve") {
+            auto fragments = make_fragments();
+            const auto* meta = &fragments["doc"]["meta"].get_ref<const json::object_t&>();
+            const auto* text = &fragments["text"].get_ref<const std::string&>();
+
+            auto result = JsonResolver().resolve(std::move(fragments), "doc");
+
+            THEN("the result is the same as a copying resolve") {
+                REQUIRE(result == expected);
+            }
+
+            THEN("values used once are moved into the result rather than copied") {
+                REQUIRE(&result["meta"].get_ref<const json::object_t&>() == meta);
+                REQUIRE(&result["text"].get_ref<const std::string&>() == text);
+            }
+        }
+
+        WHEN("the map is moved into a resolve on the bytecode engine") {
+            JsonResolverConfig config;
+            config.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+            auto fragments = make_fragments();
+            const auto* meta = &fragments["doc"]["meta"].get_ref<const json::object_t&>();
+            const auto* text = &fragments["text"].get_ref<const std::string&>();
+
+            auto result = JsonResolver(config).resolve(std::move(fragments), "doc");
+
+            THEN("literals in programs are moved as well") {
+                REQUIRE(result == expected);
+                REQUIRE(&result["meta"].get_ref<const json::object_t&>() == meta);
+                REQUIRE(&result["text"].get_ref<const std::string&>() == text);
+            }
+        }
+
+        WHEN("a configuration that may read a value twice is used") {
+            JsonResolverConfig config;
+            config.template_expansion = JsonResolverConfig::TemplateExpansion::Nested;
+            auto fragments = make_fragments();
+            fragments["label_Ada"] = "[text]";
+            fragments["doc"]["label"] = "[label_[name]]";
+
+            auto copied = JsonResolver(config).resolve(fragments, "doc");
+            auto consumed = JsonResolver(config).resolve(std::move(fragments), "doc");
+
+            THEN("values are copied and the result is unchanged") {
+                REQUIRE(consumed == copied);
+                REQUIRE(consumed["label"] == std::string(1000, 'x'));
+            }
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <type_traits>
+#include "json_fragments/node_arena.hpp"
+#include "json_fragments/fragment_implementations.hpp"
+#include "json_fragments/incremental_resolver.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+namespace {
+
+struct Counted {
+    int* destroyed;
+    std::string payload;
+    ~Counted() { ++*destroyed; }
+};
+
+} // namespace
+
+SCENARIO("NodeArena owns objects until it is destroyed", "[arena]") {
+    GIVEN("An arena holding objects with and without destructors") {
+        int destroyed = 0;
+        auto arena = std::make_unique<NodeArena>();
+        std::vector<Counted*> counted;
+        for (int i = 0; i < 1000; ++i) {
+            counted.push_back(arena->create<Counted>(Counted{&destroyed, std::to_string(i)}));
+            arena->create<int>(i);
+        }
+        destroyed = 0;  // Ignore the temporaries passed to create()
+
+        THEN("objects keep their values and addresses across a move") {
+            NodeArena moved = std::move(*arena);
+            REQUIRE(counted[0]->payload == "0");
+            REQUIRE(counted[999]->payload == "999");
+            REQUIRE(moved.bytes_used() > 0);
+            REQUIRE(arena->bytes_used() == 0);
+            *arena = std::move(moved);
+            REQUIRE(destroyed == 0);
+        }
+
+        WHEN("the arena is destroyed") {
+            arena.reset();
+
+            THEN("every object with a destructor is destroyed exactly once") {
+                REQUIRE(destroyed == 1000);
+            }
+        }
+    }
+
+    GIVEN("Arrays and strings larger than a block") {
+        NodeArena arena;
+        auto values = arena.make_array<uint64_t>(100000);
+        std::string text(200000, 'x');
+        auto copy = arena.copy_string(text);
+
+        THEN("they are allocated in blocks of their own") {
+            REQUIRE(values.size() == 100000);
+            REQUIRE(values[99999] == 0);
+            REQUIRE(copy == text);
+            REQUIRE(copy.data() != text.data());
+        }
+    }
+
+    THEN("reference, template, object and array nodes need no destructor") {
+        REQUIRE(std::is_trivially_destructible_v<ReferenceNode>);
+        REQUIRE(std::is_trivially_destructible_v<StringTemplateNode>);
+        REQUIRE(std::is_trivially_destructible_v<ObjectNode>);
+        REQUIRE(std::is_trivially_destructible_v<ArrayNode>);
+    }
+}
+
+SCENARIO("IncrementalResolver keeps working as its arena is rebuilt", "[arena][incremental]") {
+    GIVEN("A resolver whose fragments are updated many times") {
+        std::map<std::string, json> fragments;
+        fragments["host"] = "example.com";
+        fragments["url"] = "https://[host]/v0";
+        fragments["service"] = {{"url", "[url]"}, {"tags", {"a", "b"}}};
+        IncrementalResolver resolver(fragments);
+
+        WHEN("the updates far outnumber the fragments") {
+            for (int i = 1; i <= 50; ++i) {
+                resolver.update_fragment("url", "https://[host]/v" + std::to_string(i));
+                REQUIRE(resolver.resolve("service")["url"] == "https://example.com/v" + std::to_string(i));
+            }
+            resolver.update_fragment("host", "example.org");
+
+            THEN("every fragment still resolves to its latest value") {
+                auto service = resolver.resolve("service");
+                REQUIRE(service["url"] == "https://example.org/v50");
+                REQUIRE(service["tags"] == json({"a", "b"}));
+            }
+        }
+    }
+}
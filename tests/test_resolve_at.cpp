@@ -0,0 +1,102 @@
+#include <catch2/catch_test_macros.hpp>
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/exceptions.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+namespace {
+
+// Every pointer into a value, the root included
+void collect_pointers(const json& value, const json::json_pointer& at, std::vector<json::json_pointer>& out) {
+    out.push_back(at);
+    if (value.is_object()) {
+        for (const auto& [key, child] : value.items()) {
+            collect_pointers(child, at / key, out);
+        }
+    } else if (value.is_array()) {
+        for (size_t i = 0; i < value.size(); ++i) {
+            collect_pointers(value[i], at / i, out);
+        }
+    }
+}
+
+} // namespace
+
+SCENARIO("Values can be resolved at a JSON pointer", "[resolver][pointer]") {
+    GIVEN("A document made of references, templates and nested containers") {
+        std::map<std::string, json> fragments;
+        fragments["host"] = "example.org";
+        fragments["api"] = {{"endpoint", "https://[host]/api"}, {"retries", 3}};
+        fragments["servers"] = json::array({"[host]", {{"name", "backup"}}});
+        fragments["config"] = {
+            {"api_url", "[api]"},
+            {"servers", "[servers]"},
+            {"a/b~c", "escaped"},
+            {"[host]", "dynamic key"},
+            {"static", {{"deep", {1, 2, 3}}}}
+        };
+
+        JsonResolver resolver;
+        json document = resolver.resolve(fragments, "config");
+        std::vector<json::json_pointer> pointers;
+        collect_pointers(document, json::json_pointer(), pointers);
+
+        THEN("every pointer gives the same value as projecting the full result") {
+            auto compiled = CompiledFragmentSet::compile(fragments);
+            JsonResolverConfig bytecode;
+            bytecode.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+            auto compiled_bytecode = CompiledFragmentSet::compile(fragments, bytecode);
+
+            for (const auto& pointer : pointers) {
+                REQUIRE(resolver.resolve_at(fragments, "config", pointer) == document.at(pointer));
+                REQUIRE(compiled.resolve_at("config", pointer) == document.at(pointer));
+                REQUIRE(compiled_bytecode.resolve_at("config", pointer) == document.at(pointer));
+            }
+        }
+
+        THEN("pointers that lead nowhere throw an appropriate exception") {
+            for (const char* pointer : {"/missing", "/static/deep/3", "/static/deep/01",
+                                        "/static/deep/-", "/api_url/retries/x", "/a~1b~0c/0"}) {
+                REQUIRE_THROWS_AS(resolver.resolve_at(fragments, "config", json::json_pointer(pointer)),
+                                  PointerNotFoundError);
+            }
+        }
+    }
+
+    GIVEN("A document whose other branches would fail to evaluate") {
+        std::map<std::string, json> fragments;
+        fragments["value"] = "wanted";
+        fragments["doc"] = {{"good", {{"inner", "[value]"}}}, {"bad", "[absent]"}, {"list", {"[absent]", "[value]"}}};
+
+        JsonResolver resolver;
+
+        THEN("only the nodes on the path are evaluated") {
+            REQUIRE_THROWS_AS(resolver.resolve(fragments, "doc"), FragmentNotFoundError);
+            REQUIRE(resolver.resolve_at(fragments, "doc", json::json_pointer("/good/inner")) == "wanted");
+            REQUIRE(resolver.resolve_at(fragments, "doc", json::json_pointer("/list/1")) == "wanted");
+        }
+
+        THEN("the bytecode engine evaluates only the path too") {
+            JsonResolverConfig config;
+            config.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+            JsonResolver bytecode(config);
+
+            REQUIRE_THROWS_AS(bytecode.resolve(fragments, "doc"), FragmentNotFoundError);
+            REQUIRE(bytecode.resolve_at(fragments, "doc", json::json_pointer("/good/inner")) == "wanted");
+            REQUIRE(bytecode.resolve_at(fragments, "doc", json::json_pointer("/list/1")) == "wanted");
+        }
+
+        THEN("fewer references are followed") {
+            JsonResolverConfig config;
+            config.missing_fragment_behavior = JsonResolverConfig::MissingFragmentBehavior::UseDefault;
+            JsonResolver lenient(config);
+
+            ResolveStats full, partial;
+            lenient.resolve(fragments, "doc", &full);
+            lenient.resolve_at(fragments, "doc", json::json_pointer("/good"), &partial);
+            REQUIRE(partial.reference_lookups < full.reference_lookups);
+        }
+    }
+}
@@ -0,0 +1,198 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+#include <chrono>
+#include <sstream>
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/exceptions.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+namespace {
+
+// "level0" refers to "level1" twice, which refers to "level2" twice, and so
+// on, so the resolved document doubles in size with every level
+std::map<std::string, json> make_doubling(size_t levels) {
+    std::map<std::string, json> fragments;
+    for (size_t i = 0; i < levels; ++i) {
+        std::string next = "[level" + std::to_string(i + 1) + "]";
+        fragments["level" + std::to_string(i)] = {next, next};
+    }
+    fragments["level" + std::to_string(levels)] = "leaf";
+    return fragments;
+}
+
+std::map<std::string, json> make_chain(size_t depth) {
+    std::map<std::string, json> fragments;
+    for (size_t i = 0; i < depth; ++i) {
+        fragments["link" + std::to_string(i)] = {{"next", "[link" + std::to_string(i + 1) + "]"}};
+    }
+    fragments["link" + std::to_string(depth)] = "end";
+    return fragments;
+}
+
+std::string limit_message(const JsonResolver& resolver, const std::map<std::string, json>& fragments,
+                          const std::string& start) {
+    try {
+        resolver.resolve(fragments, start);
+    } catch (const ResourceLimitError& e) {
+        return e.what();
+    }
+    return std::string();
+}
+
+} // namespace
+
+SCENARIO("Resolves can be bounded by resource limits", "[limits]") {
+    GIVEN("Fragments whose output doubles at every level") {
+        auto fragments = make_doubling(16);
+
+        THEN("without limits the document is resolved in full") {
+            REQUIRE(JsonResolver().resolve(fragments, "level6").size() == 2);
+        }
+
+        WHEN("output bytes are limited") {
+            JsonResolverConfig config;
+            config.limits.max_output_bytes = 10000;
+            JsonResolver resolver(config);
+
+            THEN("small documents still resolve") {
+                REQUIRE(resolver.resolve(fragments, "level12")[0][0][0] == json({"leaf", "leaf"}));
+            }
+
+            THEN("a document past the limit throws ResourceLimitError") {
+                REQUIRE_THAT(limit_message(resolver, fragments, "level0"),
+                             Catch::Matchers::ContainsSubstring("output bytes"));
+            }
+
+            THEN("compiled sets, streaming and the bytecode engine check it too") {
+                auto compiled = CompiledFragmentSet::compile(fragments, config);
+                REQUIRE_THROWS_AS(compiled.resolve("level0"), ResourceLimitError);
+                std::ostringstream out;
+                REQUIRE_THROWS_AS(compiled.resolve_to("level0", out), ResourceLimitError);
+
+                config.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+                REQUIRE_THROWS_AS(JsonResolver(config).resolve(fragments, "level0"), ResourceLimitError);
+            }
+        }
+    }
+
+    GIVEN("Large literals spread over fragments that are each referenced once") {
+        std::map<std::string, json> fragments;
+        json parts = json::array();
+        for (int i = 0; i < 8; ++i) {
+            std::string name = "part" + std::to_string(i);
+            fragments[name] = {{"blob", std::string(2000, 'x')}, {"id", "[id]"}};
+            parts.push_back("[" + name + "]");
+        }
+        fragments["id"] = 7;
+        fragments["doc"] = parts;
+
+        WHEN("output bytes are limited below their total size") {
+            JsonResolverConfig config;
+            config.limits.max_output_bytes = 10000;
+
+            THEN("the literals count against the limit under both engines") {
+                REQUIRE_THROWS_AS(JsonResolver(config).resolve(fragments, "doc"), ResourceLimitError);
+                auto compiled = CompiledFragmentSet::compile(fragments, config);
+                REQUIRE_THROWS_AS(compiled.resolve("doc"), ResourceLimitError);
+                std::ostringstream out;
+                REQUIRE_THROWS_AS(compiled.resolve_to("doc", out), ResourceLimitError);
+
+                config.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+                REQUIRE_THROWS_AS(JsonResolver(config).resolve(fragments, "doc"), ResourceLimitError);
+                REQUIRE_THROWS_AS(CompiledFragmentSet::compile(fragments, config).resolve("doc"),
+                                  ResourceLimitError);
+            }
+
+            THEN("a pointer to one of them stays within it") {
+                auto compiled = CompiledFragmentSet::compile(fragments, config);
+                REQUIRE(compiled.resolve_at("doc", json::json_pointer("/3/blob")).get<std::string>().size() == 2000);
+            }
+        }
+    }
+
+    GIVEN("A long chain of references") {
+        auto fragments = make_chain(50);
+
+        WHEN("depth is limited") {
+            JsonResolverConfig config;
+            config.limits.max_depth = 20;
+            JsonResolver resolver(config);
+
+            THEN("shallow starts resolve and deep ones throw") {
+                REQUIRE(resolver.resolve(fragments, "link35").dump() ==
+                        JsonResolver().resolve(fragments, "link35").dump());
+                REQUIRE_THAT(limit_message(resolver, fragments, "link0"),
+                             Catch::Matchers::ContainsSubstring("nesting deeper than 20"));
+            }
+
+            THEN("evaluating a compiled set is limited as well") {
+                auto compiled = CompiledFragmentSet::compile(fragments, config);
+                REQUIRE_THROWS_AS(compiled.resolve("link0"), ResourceLimitError);
+            }
+
+            THEN("descending a compiled set along a pointer counts every fragment passed") {
+                // Both end at link40, whose value is ten fragments deep
+                std::string pointer;
+                for (int i = 0; i < 40; ++i) pointer += "/next";
+                auto compiled = CompiledFragmentSet::compile(fragments, config);
+
+                REQUIRE(compiled.resolve_at("link35", json::json_pointer("/next/next/next/next/next")) ==
+                        compiled.resolve("link40"));
+                REQUIRE_THROWS_AS(compiled.resolve_at("link0", json::json_pointer(pointer)), ResourceLimitError);
+            }
+        }
+
+        WHEN("nodes are limited") {
+            JsonResolverConfig config;
+            config.limits.max_nodes = 30;
+            JsonResolver resolver(config);
+
+            THEN("a parse that creates more nodes throws") {
+                REQUIRE(resolver.resolve(fragments, "link45")["next"]["next"].is_object());
+                REQUIRE_THAT(limit_message(resolver, fragments, "link0"),
+                             Catch::Matchers::ContainsSubstring("nodes"));
+            }
+        }
+
+        WHEN("the time limit has already passed") {
+            JsonResolverConfig config;
+            config.limits.time_limit = std::chrono::nanoseconds(1);
+            JsonResolver resolver(config);
+
+            THEN("the resolve stops at its next check") {
+                REQUIRE_THAT(limit_message(resolver, fragments, "link0"),
+                             Catch::Matchers::ContainsSubstring("time limit"));
+            }
+        }
+    }
+
+    GIVEN("Nested templates that double their text at every level") {
+        std::map<std::string, json> fragments;
+        for (int i = 0; i < 20; ++i) {
+            std::string next = "[text" + std::to_string(i + 1) + "]";
+            fragments["text" + std::to_string(i)] = next + next;
+        }
+        fragments["text20"] = "x";
+        fragments["inner"] = "text20";
+        fragments["built"] = "[[inner]]";
+        JsonResolverConfig config;
+        config.template_expansion = JsonResolverConfig::TemplateExpansion::Nested;
+
+        THEN("passes over one template are limited") {
+            REQUIRE(JsonResolver(config).resolve(fragments, "built") == "x");
+            config.limits.max_template_passes = 1;
+            REQUIRE_THAT(limit_message(JsonResolver(config), fragments, "built"),
+                         Catch::Matchers::ContainsSubstring("more than 1 template passes"));
+        }
+
+        THEN("the text they build is limited") {
+            config.limits.max_output_bytes = 1 << 16;
+            REQUIRE(JsonResolver(config).resolve(fragments, "text8").get_ref<const std::string&>().size() == 4096);
+            REQUIRE_THAT(limit_message(JsonResolver(config), fragments, "text0"),
+                         Catch::Matchers::ContainsSubstring("output bytes"));
+        }
+    }
+}
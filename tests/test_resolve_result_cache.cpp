@@ -0,0 +1,141 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/incremental_resolver.hpp"
+#include "json_fragments/resolve_result_cache.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+namespace {
+
+ResolvedFragmentPtr value(int number) {
+    return std::make_shared<const json>(number);
+}
+
+} // namespace
+
+SCENARIO("ResolveResultCache keeps the most recently used results", "[result_cache]") {
+    GIVEN("A cache with room for two results") {
+        ResolveResultCache cache(2);
+        ResolveResultCache::Key a{1, "a", 0}, b{1, "b", 0}, c{1, "c", 0};
+        cache.store(a, value(1));
+        cache.store(b, value(2));
+
+        WHEN("one is used and a third is added") {
+            REQUIRE(*cache.find(a) == 1);
+            cache.store(c, value(3));
+
+            THEN("the least recently used one is dropped") {
+                REQUIRE(cache.size() == 2);
+                REQUIRE(cache.find(b) == nullptr);
+                REQUIRE(*cache.find(a) == 1);
+                REQUIRE(*cache.find(c) == 3);
+            }
+        }
+
+        WHEN("looking up keys that differ in one field") {
+            THEN("none of them match") {
+                REQUIRE(cache.find({2, "a", 0}) == nullptr);
+                REQUIRE(cache.find({1, "a", 1}) == nullptr);
+                REQUIRE(cache.find({1, "A", 0}) == nullptr);
+                REQUIRE(cache.hits() == 0);
+                REQUIRE(cache.misses() == 3);
+            }
+        }
+
+        WHEN("it is cleared") {
+            cache.clear();
+
+            THEN("nothing is found") {
+                REQUIRE(cache.size() == 0);
+                REQUIRE(cache.find(a) == nullptr);
+            }
+        }
+    }
+
+    GIVEN("Configurations that differ only in fields that shape results") {
+        JsonResolverConfig base;
+        JsonResolverConfig other_default = base;
+        other_default.default_value = "fallback";
+        JsonResolverConfig other_engine = base;
+        other_engine.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+
+        THEN("only the result-shaping fields change the hash") {
+            REQUIRE(ResolveResultCache::config_hash(base) != ResolveResultCache::config_hash(other_default));
+            REQUIRE(ResolveResultCache::config_hash(base) == ResolveResultCache::config_hash(other_engine));
+        }
+    }
+}
+
+SCENARIO("Compiled sets and incremental resolvers reuse cached results", "[result_cache]") {
+    GIVEN("Fragments and a config with a result cache") {
+        std::map<std::string, json> fragments;
+        fragments["name"] = "Alice";
+        fragments["user"] = {{"name", "[name]"}, {"greeting", "Hi [name]"}};
+
+        JsonResolverConfig config;
+        config.result_cache = std::make_shared<ResolveResultCache>(16);
+
+        WHEN("a compiled set resolves the same start fragment twice") {
+            auto compiled = CompiledFragmentSet::compile(fragments, config);
+            auto first = compiled.resolve_shared("user");
+            auto second = compiled.resolve_shared("user");
+
+            THEN("the second result is the cached one") {
+                REQUIRE(first == second);
+                REQUIRE(*first == CompiledFragmentSet::compile(fragments).resolve("user"));
+                REQUIRE(compiled.resolve("user") == *first);
+                REQUIRE(config.result_cache->hits() == 2);
+            }
+        }
+
+        WHEN("two sets with different fragments share the cache") {
+            auto alice = CompiledFragmentSet::compile(fragments, config);
+            fragments["name"] = "Bob";
+            auto bob = CompiledFragmentSet::compile(fragments, config);
+
+            THEN("each gets its own result") {
+                REQUIRE(alice.resolve("user")["name"] == "Alice");
+                REQUIRE(bob.resolve("user")["name"] == "Bob");
+                REQUIRE(config.result_cache->size() == 2);
+            }
+        }
+
+        WHEN("an incremental resolver is updated between resolves") {
+            IncrementalResolver live(fragments, config);
+            auto before = live.resolve_shared("user");
+            REQUIRE(live.resolve_shared("user") == before);
+
+            live.update_fragment("name", "Carol");
+
+            THEN("results from before the update are not returned") {
+                REQUIRE(live.resolve("user")["name"] == "Carol");
+                REQUIRE((*before)["name"] == "Alice");
+            }
+        }
+
+        WHEN("many threads resolve through the cache at once") {
+            auto compiled = CompiledFragmentSet::compile(fragments, config);
+            std::vector<json> results(8);
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < results.size(); ++t) {
+                threads.emplace_back([&, t] {
+                    for (int i = 0; i < 100; ++i) {
+                        results[t] = compiled.resolve("user");
+                    }
+                });
+            }
+            for (auto& thread : threads) thread.join();
+
+            THEN("they all get the same result") {
+                for (const auto& result : results) {
+                    REQUIRE(result == results.front());
+                }
+                REQUIRE(config.result_cache->size() == 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,148 @@
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <sstream>
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/thread_pool.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+SCENARIO("Resolves can report what they did", "[stats]") {
+    GIVEN("Fragments with a shared reference and a template") {
+        std::map<std::string, json> fragments;
+        fragments["first"] = "Alice";
+        fragments["name"] = "[first] Smith";
+        fragments["greeting"] = "Hello, [name]!";
+        fragments["user"] = {{"name", "[name]"}, {"again", "[name]"}, {"tags", {"[greeting]", 1}}};
+
+        JsonResolver resolver;
+
+        WHEN("resolving with statistics") {
+            ResolveStats stats;
+            auto result = resolver.resolve(fragments, "user", &stats);
+
+            THEN("the result is unchanged") {
+                REQUIRE(result == resolver.resolve(fragments, "user"));
+            }
+
+            THEN("nodes are counted by type") {
+                REQUIRE(stats.object_nodes == 1);
+                REQUIRE(stats.array_nodes == 1);
+                REQUIRE(stats.template_nodes == 2);
+                REQUIRE(stats.reference_nodes == 3);
+                REQUIRE(stats.literal_nodes >= 2);
+            }
+
+            THEN("each fragment is entered once by the cycle check") {
+                REQUIRE(stats.cycle_check_visits == 4);
+            }
+
+            THEN("repeated references are answered by the memo") {
+                REQUIRE(stats.reference_lookups == 5);
+                REQUIRE(stats.memo_hits == 2);
+                REQUIRE(stats.cache_hits == 0);
+                REQUIRE(stats.template_substitutions == 2);
+                REQUIRE(stats.template_passes == 2);
+            }
+
+            THEN("every evaluated fragment has an entry, and constants need no evaluation") {
+                REQUIRE(stats.fragments.size() == 3);
+                REQUIRE(stats.fragments.count("first") == 0);
+                REQUIRE(stats.fragments.at("user").evaluations == 1);
+                REQUIRE(stats.fragments.at("user").time >= stats.fragments.at("name").time);
+                REQUIRE(stats.fragments.at("name").evaluations == 1);
+                REQUIRE(stats.fragments.at("greeting").evaluations == 1);
+                REQUIRE(stats.evaluate_time >= stats.fragments.at("greeting").time);
+            }
+        }
+
+        WHEN("resolving twice into the same statistics") {
+            ResolveStats stats;
+            resolver.resolve(fragments, "user", &stats);
+            std::ostringstream out;
+            resolver.resolve_to(fragments, "user", out, &stats);
+
+            THEN("the counters accumulate") {
+                REQUIRE(stats.object_nodes == 2);
+                REQUIRE(stats.cycle_check_visits == 8);
+            }
+        }
+    }
+
+    GIVEN("A nested template expanded in several passes") {
+        std::map<std::string, json> fragments;
+        fragments["inner"] = "x";
+        fragments["outer"] = "<[inner]>";
+        fragments["text"] = "a [outer] b";
+
+        JsonResolverConfig config;
+        config.template_expansion = JsonResolverConfig::TemplateExpansion::Nested;
+        JsonResolver resolver(config);
+
+        WHEN("resolving with statistics") {
+            ResolveStats stats;
+            REQUIRE(resolver.resolve(fragments, "text", &stats) == "a <x> b");
+
+            THEN("every pass and substitution is counted") {
+                REQUIRE(stats.template_substitutions == 2);
+                REQUIRE(stats.template_passes >= 2);
+                REQUIRE(stats.bytes_copied > 0);
+            }
+        }
+    }
+
+    GIVEN("A deeply nested document with one reference at the bottom") {
+        const int depth = 500;
+        json doc = "[leaf]";
+        json constant = "done";
+        for (int i = 0; i < depth; ++i) {
+            doc = json::array({1, doc});
+            constant = json::array({1, constant});
+        }
+        std::map<std::string, json> fragments;
+        fragments["leaf"] = "bottom";
+        fragments["doc"] = {{"path", doc}, {"constant", constant}};
+
+        WHEN("resolving with statistics") {
+            ResolveStats stats;
+            json result = JsonResolver().resolve(fragments, "doc", &stats);
+
+            THEN("containers on the path get nodes and constant subtrees get one literal each") {
+                REQUIRE(result["constant"] == constant);
+                REQUIRE(result["path"].flatten().size() == depth + 1);
+                REQUIRE(stats.array_nodes == depth);
+                REQUIRE(stats.object_nodes == 1);
+                REQUIRE(stats.reference_nodes == 1);
+                // A literal for each 1 on the path, one for the constant
+                // subtree, two keys and the leaf fragment
+                REQUIRE(stats.literal_nodes == depth + 4);
+            }
+        }
+    }
+
+    GIVEN("A compiled set evaluated in parallel") {
+        std::map<std::string, json> fragments;
+        fragments["item"] = "value";
+        json wide = json::array();
+        for (int i = 0; i < 64; ++i) {
+            wide.push_back("[item]");
+        }
+        fragments["wide"] = wide;
+
+        JsonResolverConfig config;
+        config.parallel.pool = std::make_shared<ThreadPool>(2);
+        config.parallel.min_children = 2;
+        auto compiled = CompiledFragmentSet::compile(fragments, config);
+
+        WHEN("resolving with statistics") {
+            ResolveStats stats;
+            compiled.resolve("wide", &stats);
+
+            THEN("work done on every thread is counted") {
+                REQUIRE(stats.reference_lookups == 64);
+                REQUIRE(stats.object_nodes == 0);
+            }
+        }
+    }
+}
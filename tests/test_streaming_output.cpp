@@ -0,0 +1,102 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+#include "json_fragments/json_resolver.hpp"
+#include "json_fragments/compiled_fragment_set.hpp"
+#include "json_fragments/exceptions.hpp"
+
+using json = nlohmann::json;
+using namespace json_fragments;
+
+namespace {
+
+std::string stream(const CompiledFragmentSet& compiled, const std::string& start) {
+    std::ostringstream out;
+    compiled.resolve_to(start, out);
+    return out.str();
+}
+
+} // namespace
+
+SCENARIO("Resolved fragments can be written straight to a stream", "[streaming]") {
+    GIVEN("Fragments with literals, references, templates and dynamic keys") {
+        std::map<std::string, json> fragments;
+        fragments["name"] = "Zoë \"quoted\"\n";
+        fragments["field"] = "alpha";
+        fragments["late"] = "zulu";
+        fragments["shared"] = {{"pi", 3.14159}, {"big", 1e300}, {"list", {1, -2, nullptr, false}}};
+        fragments["user"] = {
+            {"name", "[name]"},
+            {"greeting", "Hi [field]!"},
+            {"[field]", "first"},
+            {"[late]", "[shared]"},
+            {"m", {{"x", "[shared]"}, {"y", json::object()}, {"z", json::array()}}},
+            {"rows", {"[field]", {{"k", "[late]"}}, "plain"}}
+        };
+        // Computed keys that collide with a literal key; the later entry wins
+        fragments["beta_key"] = "b";
+        fragments["collide"] = {{"b", "literal"}, {"[beta_key]", "computed"}};
+
+        WHEN("streaming from a compiled set") {
+            auto compiled = CompiledFragmentSet::compile(fragments);
+
+            THEN("the text matches dumping the resolved document") {
+                for (const auto& start : {"user", "shared", "name", "collide"}) {
+                    REQUIRE(stream(compiled, start) == compiled.resolve(start).dump());
+                }
+            }
+        }
+
+        WHEN("streaming with the one-shot resolver") {
+            JsonResolver resolver;
+            std::ostringstream out;
+            resolver.resolve_to(fragments, "user", out);
+
+            THEN("the text matches dumping the resolved document") {
+                REQUIRE(out.str() == resolver.resolve(fragments, "user").dump());
+                REQUIRE(json::parse(out.str())["alpha"] == "first");
+            }
+        }
+
+        WHEN("streaming with the bytecode engine") {
+            JsonResolverConfig config;
+            config.engine = JsonResolverConfig::EvaluationEngine::Bytecode;
+            auto compiled = CompiledFragmentSet::compile(fragments, config);
+
+            THEN("the text is the same") {
+                REQUIRE(stream(compiled, "user") == compiled.resolve("user").dump());
+            }
+        }
+    }
+
+    GIVEN("References to missing fragments") {
+        std::map<std::string, json> fragments;
+        fragments["doc"] = {{"value", "[missing]"}, {"list", {"[missing]", 1}}};
+
+        THEN("each missing-fragment behavior is written like resolve() builds it") {
+            using Behavior = JsonResolverConfig::MissingFragmentBehavior;
+            for (auto behavior : {Behavior::LeaveUnresolved, Behavior::UseDefault, Behavior::Remove}) {
+                JsonResolverConfig config;
+                config.missing_fragment_behavior = behavior;
+                config.default_value = {{"fallback", true}};
+                auto compiled = CompiledFragmentSet::compile(fragments, config);
+                REQUIRE(stream(compiled, "doc") == compiled.resolve("doc").dump());
+            }
+        }
+
+        THEN("the default behavior throws") {
+            auto compiled = CompiledFragmentSet::compile(fragments);
+            std::ostringstream out;
+            REQUIRE_THROWS_AS(compiled.resolve_to("doc", out), FragmentNotFoundError);
+        }
+    }
+
+    GIVEN("A start fragment that does not exist") {
+        auto compiled = CompiledFragmentSet::compile({{"a", 1}});
+
+        THEN("nothing is written and it throws") {
+            std::ostringstream out;
+            REQUIRE_THROWS_AS(compiled.resolve_to("missing", out), FragmentNotFoundError);
+            REQUIRE(out.str().empty());
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "json_fragments/thread_pool.hpp"
+
+using namespace json_fragments;
+
+SCENARIO("ThreadPool runs parallel loops", "[threads]") {
+    GIVEN("A pool with a few workers") {
+        ThreadPool pool(3);
+
+        WHEN("running a loop over many indices") {
+            std::vector<int> hits(1000, 0);
+            pool.parallel_for(hits.size(), [&](size_t i) { hits[i] += 1; });
+
+            THEN("every index is visited exactly once") {
+                for (int hit : hits) {
+                    REQUIRE(hit == 1);
+                }
+            }
+        }
+
+        WHEN("a loop body throws") {
+            THEN("the exception reaches the caller") {
+                REQUIRE_THROWS_AS(
+                    pool.parallel_for(100, [](size_t i) {
+                        if (i == 42) throw std::runtime_error("boom");
+                    }),
+                    std::runtime_error
+                );
+            }
+        }
+
+        WHEN("loops are nested inside pool tasks") {
+            std::atomic<int> total{0};
+            pool.parallel_for(8, [&](size_t) {
+                pool.parallel_for(8, [&](size_t) { ++total; });
+            });
+
+            THEN("they complete without deadlocking") {
+                REQUIRE(total == 64);
+            }
+        }
+    }
+}